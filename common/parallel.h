@@ -0,0 +1,205 @@
+#ifndef MESHSIMPLIFICATION_PARALLEL_H
+#define MESHSIMPLIFICATION_PARALLEL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Number of worker threads to use, 0 means one per hardware thread
+
+inline unsigned int thread_count(unsigned int requested = 0) {
+    if (requested != 0) {
+        return requested;
+    }
+
+    unsigned int hardware = std::thread::hardware_concurrency();
+
+    return hardware != 0 ? hardware : 1;
+}
+
+//
+// Split [begin, end) into one contiguous range per thread and call
+// func(thread_id, range_begin, range_end) for each of them. Ranges and thread ids
+// only depend on the thread count, small ranges are processed on the calling thread.
+//
+template <typename TFunc>
+void parallel_for(unsigned int threads, int begin, int end, TFunc func, int min_range = 1024) {
+    threads = thread_count(threads);
+
+    int count = end - begin;
+    int chunk = std::max(min_range, (count + static_cast<int>(threads) - 1) / static_cast<int>(threads));
+
+    if (threads <= 1 || count <= chunk) {
+        func(0u, begin, end);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+
+    for (unsigned int t = 1; t < threads; t++) {
+        int range_begin = begin + static_cast<int>(t) * chunk;
+        int range_end = std::min(end, range_begin + chunk);
+
+        if (range_begin >= range_end) {
+            break;
+        }
+
+        workers.emplace_back(func, t, range_begin, range_end);
+    }
+
+    func(0u, begin, std::min(end, begin + chunk));
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+
+//
+// Worker threads kept between parallel_for calls, so passes that run many short
+// rounds don't start threads every time. run(tasks, func) calls func(task) for every
+// task below the thread count, task 0 on the calling thread, and returns when all are
+// done. Calls must not be nested and must come from one thread at a time.
+//
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int threads) : m_size(thread_count(threads)) {
+        for (unsigned int t = 1; t < m_size; t++) {
+            m_workers.emplace_back([this, t]() { work(t); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+
+        m_start.notify_all();
+
+        for (auto &worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(ThreadPool const &) = delete;
+    ThreadPool &operator=(ThreadPool const &) = delete;
+
+    unsigned int size() const {
+        return m_size;
+    }
+
+    template <typename TFunc>
+    void run(unsigned int tasks, TFunc func) {
+        tasks = std::min(tasks, m_size);
+
+        if (tasks <= 1) {
+            func(0u);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_task = func;
+            m_tasks = tasks;
+            m_pending = tasks - 1;
+            m_generation++;
+        }
+
+        m_start.notify_all();
+        func(0u);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_pending == 0; });
+        m_task = nullptr;
+    }
+
+private:
+    void work(unsigned int thread) {
+        unsigned long long generation = 0;
+
+        while (true) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [&]() { return m_stop || m_generation != generation; });
+
+            if (m_stop) return;
+
+            generation = m_generation;
+            if (thread >= m_tasks) continue;
+
+            lock.unlock();
+            m_task(thread);
+            lock.lock();
+
+            if (--m_pending == 0) m_done.notify_one();
+        }
+    }
+
+    unsigned int m_size;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_start, m_done;
+    std::function<void(unsigned int)> m_task;
+    unsigned int m_tasks = 0;
+    unsigned int m_pending = 0;
+    unsigned long long m_generation = 0;
+    bool m_stop = false;
+};
+
+//
+// Pool started on first use and restarted when the thread count changes. A copy starts
+// without workers, so objects holding one stay copyable and never share a pool.
+//
+class LazyThreadPool {
+public:
+    LazyThreadPool() = default;
+    LazyThreadPool(LazyThreadPool const &) {}
+    LazyThreadPool(LazyThreadPool &&) = default;
+
+    LazyThreadPool &operator=(LazyThreadPool const &) {
+        return *this;
+    }
+
+    LazyThreadPool &operator=(LazyThreadPool &&) = default;
+
+    ThreadPool &get(unsigned int threads) {
+        if (!m_pool || m_pool->size() != thread_count(threads)) {
+            m_pool.reset(new ThreadPool(threads));
+        }
+
+        return *m_pool;
+    }
+
+private:
+    std::unique_ptr<ThreadPool> m_pool;
+};
+
+//
+// parallel_for on the workers of a pool, with the ranges of the thread count version
+// for the same number of threads
+//
+template <typename TFunc>
+void parallel_for(ThreadPool &pool, int begin, int end, TFunc func, int min_range = 1024) {
+    int threads = static_cast<int>(pool.size());
+    int count = end - begin;
+    int chunk = std::max(min_range, (count + threads - 1) / threads);
+
+    if (threads <= 1 || count <= chunk) {
+        func(0u, begin, end);
+        return;
+    }
+
+    pool.run(static_cast<unsigned int>((count + chunk - 1) / chunk), [&](unsigned int thread) {
+        int range_begin = begin + static_cast<int>(thread) * chunk;
+        func(thread, range_begin, std::min(end, range_begin + chunk));
+    });
+}
+
+
+#endif //MESHSIMPLIFICATION_PARALLEL_H
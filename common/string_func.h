@@ -34,7 +34,8 @@ static std::vector<std::string> string_split(std::string const &str, std::string
         last_dlm_index = next_dlm_index;
     }
 
-    if (last_dlm_index < str.size() - 1) {
+    // signed, with start_pos 0 and no delimiter last_dlm_index is -1
+    if (last_dlm_index + 1 < static_cast<int>(str.size())) {
         v.push_back(str.substr(last_dlm_index + 1, str.size()));
     }
 
@@ -77,11 +77,17 @@ Application::Application() {
 
     imguiInit();
 
-    m_mesh.load_from_file("./house.obj");
-    m_mesh.calculate_normals();
+    loadMesh("./house.obj");
     m_mesh_need_reload = false;
 }
 
+void Application::loadMesh(std::string const &fileName) {
+    m_mesh.load_from_file(fileName);
+    m_mesh.calculate_normals();
+
+    m_original_surface = Measure::surface(m_mesh);
+}
+
 void Application::setCallBacks() {
     glfwSetMouseButtonCallback(m_window, [](GLFWwindow *window, int button, int action, int mods) {
         auto *app = Application::getInstance();
@@ -107,7 +113,7 @@ void Application::setCallBacks() {
 }
 
 Application::~Application() {
-
+    cancelSimplify();
 }
 
 Application *Application::getInstance() {
@@ -130,6 +136,87 @@ void Application::imguiInit() {
     font_config.PixelSnapH = true;
 }
 
+void Application::startSimplify(std::function<void(Mesh<VertexComponentsColored> &)> job, uint targetFaces) {
+    if (m_worker.joinable()) {
+        return;
+    }
+
+    m_worker_mesh = m_mesh.simplification_source();
+    m_worker_mesh.set_progress(&m_progress);
+
+    m_worker_start_faces = static_cast<uint>(m_worker_mesh.faces().size());
+    m_worker_target_faces = targetFaces;
+
+    m_progress.iteration = 0;
+    m_progress.triangles = static_cast<int>(m_worker_start_faces);
+    m_progress.cancel = false;
+    m_worker_done = false;
+    m_worker_records = false;
+
+    m_worker = std::thread([this, job]() {
+        auto start = std::chrono::high_resolution_clock::now();
+        job(m_worker_mesh);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::chrono::duration<float> duration = end - start;
+
+        std::cout << "full duration - " << duration.count() << std::endl;
+
+        m_worker_done = true;
+    });
+}
+
+void Application::startRecord() {
+    if (m_worker.joinable()) {
+        return;
+    }
+
+    startSimplify([this](Mesh<VertexComponentsColored> &mesh) {
+        m_worker_progressive.record(mesh);
+    }, 0);
+
+    m_worker_records = true;
+}
+
+bool Application::finishSimplify() {
+    if (!m_worker.joinable() || !m_worker_done) {
+        return false;
+    }
+
+    m_worker.join();
+
+    bool cancelled = m_progress.cancel;
+
+    if (!cancelled) {
+        if (m_worker_records) {
+            m_mesh.set_progressive(std::move(m_worker_progressive));
+        }
+        else {
+            m_mesh.assign(m_worker_mesh.vertices(), m_worker_mesh.faces());
+
+            m_stats = m_worker_mesh.stats();
+            m_has_stats = true;
+        }
+    }
+
+    m_worker_mesh = Mesh<VertexComponentsColored>();
+    m_worker_progressive.clear();
+
+    return !cancelled;
+}
+
+void Application::cancelSimplify() {
+    if (!m_worker.joinable()) {
+        return;
+    }
+
+    m_progress.cancel = true;
+    m_worker.join();
+
+    m_worker_mesh = Mesh<VertexComponentsColored>();
+    m_worker_progressive.clear();
+}
+
 void Application::run() {
     Shader shader(Shader::fromSourceFiles(
         "./shaders/vertex.glsl",
@@ -158,6 +245,12 @@ void Application::run() {
     float angle = 0.0f;
     int render_type = 0;
     float p_simplify = 0.5f;
+    float p_lod = 1.0f;
+    float p_max_error = 0.01f;
+
+    // distance between the loaded and the current surface, valid until the mesh changes
+    Measure::Comparison distance;
+    bool has_distance = false;
     glm::vec3 light_position{100, 100, 100};
 
     while (!glfwWindowShouldClose(m_window)) {
@@ -165,8 +258,10 @@ void Application::run() {
         glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 
         if (m_mesh_need_reload) {
-            m_mesh.load_from_file(m_next_mesh_load_file);
-            m_mesh.calculate_normals();
+            cancelSimplify();
+
+            loadMesh(m_next_mesh_load_file);
+            has_distance = false;
 
             m_mesh_need_reload = false;
 
@@ -177,6 +272,24 @@ void Application::run() {
             mesh_volume = m_mesh.volume();
         }
 
+        uint vertices_before = m_mesh.vertices().size();
+        uint faces_before = m_mesh.faces().size();
+
+        if (finishSimplify()) {
+            prev_mesh_vertices = vertices_before;
+            prev_mesh_faces = faces_before;
+
+            prev_mesh_area = mesh_area;
+            prev_mesh_volume = mesh_volume;
+
+            mesh_area = m_mesh.area();
+            mesh_volume = m_mesh.volume();
+
+            // a new sequence starts at the full mesh, a simplified mesh has none
+            p_lod = 1.0f;
+            has_distance = false;
+        }
+
         glfwPollEvents();
 
         ImGui_ImplOpenGL3_NewFrame();
@@ -228,23 +341,135 @@ void Application::run() {
                 ImGui::Text("Volume: %f", std::fabs(mesh_volume));
             }
 
-            if (ImGui::Button("Simplify")) {
-                prev_mesh_vertices = m_mesh.vertices().size();
-                prev_mesh_faces = m_mesh.faces().size();
+            int simplify_method = static_cast<int>(m_mesh.simplify_method());
+
+            ImGui::RadioButton("Threshold", &simplify_method, static_cast<int>(Simplify::Method::Threshold));
+            ImGui::SameLine();
+            ImGui::RadioButton("Priority queue", &simplify_method, static_cast<int>(Simplify::Method::Heap));
+            ImGui::SameLine();
+            ImGui::RadioButton("Partitioned", &simplify_method, static_cast<int>(Simplify::Method::Partitioned));
+            ImGui::SameLine();
+            ImGui::RadioButton("Clustering", &simplify_method, static_cast<int>(Simplify::Method::Clustering));
+            ImGui::SameLine();
+            ImGui::RadioButton("Parallel", &simplify_method, static_cast<int>(Simplify::Method::Parallel));
+
+            m_mesh.set_simplify_method(static_cast<Simplify::Method>(simplify_method));
+
+            // threshold from the current edge errors instead of the fixed curve
+            bool adaptive = m_mesh.threshold_schedule() == Simplify::Schedule::Adaptive;
+
+            if (ImGui::Checkbox("Adaptive threshold", &adaptive)) {
+                m_mesh.set_threshold_schedule(adaptive ? Simplify::Schedule::Adaptive : Simplify::Schedule::Fixed);
+            }
+
+            // colour and uv in the edge error, 0 simplifies by position only
+            float attribute_weight = m_mesh.attribute_weight();
+
+            if (ImGui::SliderFloat("Attribute weight", &attribute_weight, 0.0f, 1.0f)) {
+                m_mesh.set_attribute_weight(attribute_weight);
+            }
+
+            // worker threads of the parallel passes, 0 uses every hardware thread
+            int threads = static_cast<int>(m_mesh.threads());
+
+            if (ImGui::InputInt("Threads", &threads)) {
+                m_mesh.set_threads(static_cast<unsigned int>(glm::max(threads, 0)));
+            }
+
+            // clustering has no edge errors to bound
+            bool error_bounded = m_mesh.simplify_method() != Simplify::Method::Clustering;
+
+            // distance in model units the simplified surface may move
+            if (error_bounded) {
+                ImGui::InputFloat("Max error", &p_max_error, 0.001f, 0.01f, "%.4f");
+            }
+            else {
+                ImGui::TextDisabled("Max error needs an edge collapse method");
+            }
+
+            if (simplifyRunning()) {
+                int triangles = m_progress.triangles;
+
+                ImGui::Text("Simplifying - iteration %d, triangles %d", m_progress.iteration.load(), triangles);
+
+                // the error bounded mode has no target to measure against
+                if (m_worker_target_faces < m_worker_start_faces) {
+                    int removed = static_cast<int>(m_worker_start_faces) - triangles;
+                    ImGui::ProgressBar(glm::clamp(static_cast<float>(removed) / (m_worker_start_faces - m_worker_target_faces), 0.0f, 1.0f));
+                }
+
+                if (ImGui::Button("Cancel")) {
+                    m_progress.cancel = true;
+                }
+            }
+            else {
+                if (ImGui::Button("Simplify")) {
+                    float ratio = p_simplify;
+
+                    startSimplify([ratio](Mesh<VertexComponentsColored> &mesh) {
+                        mesh.simplify(ratio);
+                    }, static_cast<uint>(ratio * m_mesh.source_face_count()));
+                }
+
+                if (error_bounded) {
+                    ImGui::SameLine();
 
-                auto start = std::chrono::high_resolution_clock::now();
-                m_mesh.simplify(p_simplify);
-                auto end = std::chrono::high_resolution_clock::now();
+                    if (ImGui::Button("Simplify to error")) {
+                        float max_error = p_max_error;
 
-                std::chrono::duration<float> duration = end - start;
+                        startSimplify([max_error](Mesh<VertexComponentsColored> &mesh) {
+                            uint face_count = mesh.simplify_to_error(max_error);
+
+                            std::cout << "faces within " << max_error << " - " << face_count << std::endl;
+                        }, 0);
+                    }
+                }
+
+                ImGui::SameLine();
+
+                if (ImGui::Button("Record LOD")) {
+                    startRecord();
+                }
 
-                std::cout << "full duration - " << duration.count() << std::endl;
+                if (!m_mesh.progressive().empty()) {
+                    // replays or undoes only the collapses between the current and the new level
+                    if (ImGui::SliderFloat("LOD", &p_lod, 0.0f, 1.0f)) {
+                        m_mesh.set_lod(static_cast<uint>(p_lod * m_mesh.progressive().max_face_count()));
 
-                prev_mesh_area = mesh_area;
-                prev_mesh_volume = mesh_volume;
+                        mesh_area = m_mesh.area();
+                        mesh_volume = m_mesh.volume();
+
+                        has_distance = false;
+                    }
+                }
+
+                if (ImGui::Button("Measure")) {
+                    auto start = std::chrono::high_resolution_clock::now();
+                    distance = Measure::compare(m_original_surface, Measure::surface(m_mesh));
+                    auto end = std::chrono::high_resolution_clock::now();
+
+                    std::chrono::duration<float> duration = end - start;
+
+                    std::cout << "measure duration - " << duration.count() << std::endl;
+
+                    has_distance = true;
+                }
+            }
+
+            if (has_distance) {
+                ImGui::Text("Hausdorff: %f (%f/%f)", distance.hausdorff, distance.forward.max, distance.backward.max);
+                ImGui::Text("RMS: %f (%f/%f)", distance.rms, distance.forward.rms, distance.backward.rms);
+            }
 
-                mesh_area = m_mesh.area();
-                mesh_volume = m_mesh.volume();
+            if (m_has_stats && ImGui::TreeNode("Simplification stats")) {
+                ImGui::Text("Init: %.3f s, border: %.3f s, adjacency: %.3f s", m_stats.init_time, m_stats.border_time, m_stats.adjacency_time);
+                ImGui::Text("Collapse: %.3f s, compact: %.3f s, total: %.3f s", m_stats.collapse_time, m_stats.compact_time, m_stats.total_time());
+                ImGui::Text("Iterations: %zu", m_stats.iterations);
+                ImGui::Text("Collapses: %zu/%zu attempted, largest error %g", m_stats.collapses, m_stats.attempted, m_stats.max_collapse_error);
+                ImGui::Text("Rejected - flip: %zu, border: %zu, locked: %zu, target: %zu, dirty: %zu, overlap: %zu",
+                            m_stats.rejected_flip, m_stats.rejected_border, m_stats.rejected_locked, m_stats.rejected_target, m_stats.rejected_dirty,
+                            m_stats.rejected_overlap);
+                ImGui::TreePop();
             }
 
             ImGui::End();
@@ -3,9 +3,12 @@
 
 #include <GL/glew.h>
 
+#include <atomic>
 #include <chrono>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <thread>
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -20,6 +23,7 @@
 #include "RenderMesh.h"
 #include "Shader.h"
 #include "Simplify.h"
+#include "SurfaceDistance.h"
 
 #include "Input.h"
 
@@ -53,9 +57,25 @@ class Application {
     Camera mMainCamera;
 
     RenderMesh<VertexComponentsColored> m_mesh;
+    Measure::Surface m_original_surface;
     bool m_mesh_need_reload;
     std::string m_next_mesh_load_file;
 
+    // simplification running on a worker thread, m_mesh is replaced once it has finished
+    std::thread m_worker;
+    std::atomic<bool> m_worker_done{false};
+    Simplify::Progress m_progress;
+    Mesh<VertexComponentsColored> m_worker_mesh;
+    uint m_worker_start_faces = 0;
+    uint m_worker_target_faces = 0;
+    // set when the job records the collapse sequence instead of simplifying
+    bool m_worker_records = false;
+    ProgressiveMesh<VertexComponentsColored> m_worker_progressive;
+
+    // of the last finished run
+    Simplify::Stats m_stats;
+    bool m_has_stats = false;
+
 public:
     Application();
     virtual ~Application();
@@ -124,6 +144,22 @@ protected:
 private:
     void setCallBacks();
 
+    // Load into m_mesh and keep its surface as the reference of Measure
+    void loadMesh(std::string const &fileName);
+
+    // Run job on a copy of the mesh on the worker thread, target_faces is 0 when unknown
+    void startSimplify(std::function<void(Mesh<VertexComponentsColored> &)> job, uint targetFaces);
+    // Record the collapse sequence of the mesh on the worker thread
+    void startRecord();
+    // Swap in the result of a finished run, true when the mesh or its sequence was replaced
+    bool finishSimplify();
+    // Stop a running job and drop its result
+    void cancelSimplify();
+
+    bool simplifyRunning() const {
+        return m_worker.joinable();
+    }
+
     void run();
     void close();
 };
@@ -0,0 +1,165 @@
+#ifndef MESHSIMPLIFICATION_ATTRIBUTEQUADRIC_H
+#define MESHSIMPLIFICATION_ATTRIBUTEQUADRIC_H
+
+#include <cmath>
+
+
+//
+// Generalised quadric of Garland and Heckbert over a position followed by up to six
+// vertex attributes. For a triangle it measures the squared distance to the plane the
+// triangle spans in that space, as the matrix A (upper triangle), the vector b and c:
+// error(v) = v A v + 2 b v + c. Unused attributes stay 0 and do not change the error.
+//
+class AttributeQuadric {
+
+public:
+
+    static const int size = 9;
+    static const int packed = size * (size + 1) / 2;
+
+    AttributeQuadric() {
+        for (int i = 0; i < packed; i++) a[i] = 0;
+        for (int i = 0; i < size; i++) b[i] = 0;
+        c = 0;
+    }
+
+    // Quadric of the triangle p0 p1 p2, 0 for a degenerate one
+
+    AttributeQuadric(double const *p0, double const *p1, double const *p2) : AttributeQuadric() {
+        double e1[size], e2[size];
+
+        for (int i = 0; i < size; i++) {
+            e1[i] = p1[i] - p0[i];
+            e2[i] = p2[i] - p0[i];
+        }
+
+        double length = std::sqrt(dot(e1, e1));
+        if (length == 0) return;
+
+        for (int i = 0; i < size; i++) e1[i] /= length;
+
+        double d = dot(e1, e2);
+        for (int i = 0; i < size; i++) e2[i] -= d * e1[i];
+
+        length = std::sqrt(dot(e2, e2));
+        if (length == 0) return;
+
+        for (int i = 0; i < size; i++) e2[i] /= length;
+
+        double pe1 = dot(p0, e1);
+        double pe2 = dot(p0, e2);
+
+        for (int i = 0, k = 0; i < size; i++) {
+            for (int j = i; j < size; j++, k++) {
+                a[k] = (i == j ? 1 : 0) - e1[i] * e1[j] - e2[i] * e2[j];
+            }
+
+            b[i] = pe1 * e1[i] + pe2 * e2[i] - p0[i];
+        }
+
+        c = dot(p0, p0) - pe1 * pe1 - pe2 * pe2;
+    }
+
+    AttributeQuadric& operator+=(const AttributeQuadric& n)
+    {
+        for (int i = 0; i < packed; i++) a[i] += n.a[i];
+        for (int i = 0; i < size; i++) b[i] += n.b[i];
+        c += n.c;
+        return *this;
+    }
+
+    const AttributeQuadric operator+(const AttributeQuadric& n) const
+    {
+        AttributeQuadric r(*this);
+        r += n;
+        return r;
+    }
+
+    double error(double const *v) const {
+        double e = c;
+
+        for (int i = 0, k = 0; i < size; i++) {
+            double row = 0;
+
+            // off diagonal entries appear twice in v A v
+            for (int j = i; j < size; j++, k++) {
+                row += (i == j ? 1 : 2) * a[k] * v[j];
+            }
+
+            e += v[i] * (row + 2 * b[i]);
+        }
+
+        return e;
+    }
+
+    //
+    // Minimum of the error: solves A v = -b with a Cholesky factorisation, A is a sum
+    // of positive semidefinite matrices. Returns false and leaves v unchanged when A
+    // is (nearly) singular.
+    //
+    bool solve(double *v) const {
+        // A = L L^T, the lower triangle of m holds L
+        double m[size][size];
+        double inverse[size];
+
+        for (int i = 0, k = 0; i < size; i++) {
+            for (int j = i; j < size; j++, k++) {
+                m[j][i] = a[k];
+            }
+        }
+
+        for (int j = 0; j < size; j++) {
+            double d = m[j][j];
+
+            for (int k = 0; k < j; k++) d -= m[j][k] * m[j][k];
+
+            if (d < 1e-10) return false;
+
+            inverse[j] = 1 / std::sqrt(d);
+
+            for (int i = j + 1; i < size; i++) {
+                double s = m[i][j];
+
+                for (int k = 0; k < j; k++) s -= m[i][k] * m[j][k];
+
+                m[i][j] = s * inverse[j];
+            }
+        }
+
+        double x[size];
+
+        for (int i = 0; i < size; i++) {
+            double s = -b[i];
+
+            for (int k = 0; k < i; k++) s -= m[i][k] * x[k];
+
+            x[i] = s * inverse[i];
+        }
+
+        for (int i = size - 1; i >= 0; i--) {
+            double s = x[i];
+
+            for (int k = i + 1; k < size; k++) s -= m[k][i] * x[k];
+
+            x[i] = s * inverse[i];
+        }
+
+        for (int i = 0; i < size; i++) v[i] = x[i];
+
+        return true;
+    }
+
+    double a[packed];
+    double b[size];
+    double c;
+
+private:
+    static double dot(double const *u, double const *v) {
+        double d = 0;
+        for (int i = 0; i < size; i++) d += u[i] * v[i];
+        return d;
+    }
+};
+
+
+#endif //MESHSIMPLIFICATION_ATTRIBUTEQUADRIC_H
@@ -1,21 +1,45 @@
 #ifndef MESHSIMPLIFICATION_MESH_H
 #define MESHSIMPLIFICATION_MESH_H
 
+#include <algorithm>
 #include <type_traits>
 #include <glm/glm.hpp>
+#include <fstream>
 #include <iostream>
+#include <numeric>
 #include <vector>
 
 #include "Simplify.h"
 #include "OBJReader.h"
-
-#define VTABLE_OFFSET 8
+#include "../common/parallel.h"
 
 using uchar = unsigned char;
 using uint = unsigned int;
 
 
-float tetrahedronSignedVolume(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2);
+// Compensated (Neumaier) sum, the rounding error stays bounded over millions of terms
+
+struct KahanSum {
+    double sum = 0;
+    double compensation = 0;
+
+    void add(double value) {
+        double t = sum + value;
+
+        if (std::abs(sum) >= std::abs(value)) {
+            compensation += (sum - t) + value;
+        }
+        else {
+            compensation += (value - t) + sum;
+        }
+
+        sum = t;
+    }
+
+    double value() const {
+        return sum + compensation;
+    }
+};
 
 
 template <typename T>
@@ -24,8 +48,21 @@ T linearInterpolation(const T &v0, const T &v1, float t) {
 }
 
 
+// Byte offset of a member, offsetof is only defined for standard layout types
+
+template <typename T, typename M>
+int memberOffset(M T::*member) {
+    T object{};
+    return static_cast<int>(reinterpret_cast<uchar const *>(&(object.*member)) - reinterpret_cast<uchar const *>(&object));
+}
+
+
+//
+// Base of the vertex components. It has no virtual functions, so vertices are trivially
+// copyable and are read, uploaded and written as plain memory. Components have
+// interpolate(v0, v1, t) for their own type, the attribute statics and a layout().
+//
 struct VertexComponents {
-    virtual void interpolate(VertexComponents const &v0, VertexComponents const &v1, float t) = 0;
 };
 
 
@@ -33,13 +70,22 @@ struct VertexBaseComponents : public VertexComponents {
     glm::vec3 position;
     glm::vec3 normal;
 
-    void interpolate(VertexComponents const &v0, VertexComponents const &v1, float t) override {
-        auto &_v0 = static_cast<VertexBaseComponents const &>(v0);
-        auto &_v1 = static_cast<VertexBaseComponents const &>(v1);
-
-        position = linearInterpolation(_v0.position, _v1.position, t);
-        normal   = linearInterpolation(_v0.normal,   _v1.normal,   t);
+    void interpolate(VertexBaseComponents const &v0, VertexBaseComponents const &v1, float t) {
+        position = linearInterpolation(v0.position, v1.position, t);
+        normal   = linearInterpolation(v0.normal,   v1.normal,   t);
     }
+
+    // Byte offsets of the channels in a vertex, -1 when missing
+
+    static OBJReader::Layout layout();
+
+    // Channels weighed by the attribute quadrics of Simplify, uv_attribute is the first uv channel or -1
+
+    static const int attribute_count = 0;
+    static const int uv_attribute = -1;
+
+    void get_attributes(float *) const {}
+    void set_attributes(float const *) {}
 };
 
 
@@ -47,22 +93,53 @@ struct VertexComponentsColored : public VertexBaseComponents {
     glm::vec4 color;
     glm::vec2 uv;
 
-    void interpolate(VertexComponents const &v0, VertexComponents const &v1, float t) override {
+    void interpolate(VertexComponentsColored const &v0, VertexComponentsColored const &v1, float t) {
         VertexBaseComponents::interpolate(v0, v1, t);
 
-        auto &_v0 = static_cast<VertexComponentsColored const &>(v0);
-        auto &_v1 = static_cast<VertexComponentsColored const &>(v1);
+        color = linearInterpolation(v0.color, v1.color, t);
+        //uv = linearInterpolation(v0.uv, v1.uv, t);
+    }
+
+    static OBJReader::Layout layout();
+
+    static const int attribute_count = 6;
+    static const int uv_attribute = 4;
+
+    void get_attributes(float *a) const {
+        a[0] = color.r; a[1] = color.g; a[2] = color.b; a[3] = color.a;
+        a[4] = uv.x; a[5] = uv.y;
+    }
 
-        color = linearInterpolation(_v0.color, _v1.color, t);
-        //uv = linearInterpolation(_v0.uv, _v1.uv, t);
+    void set_attributes(float const *a) {
+        color = glm::clamp(glm::vec4(a[0], a[1], a[2], a[3]), 0.f, 1.f);
+        uv = glm::vec2(a[4], a[5]);
     }
 };
 
 
+inline OBJReader::Layout VertexBaseComponents::layout() {
+    OBJReader::Layout layout;
+    layout.position.offset = memberOffset(&VertexBaseComponents::position);
+    layout.normal.offset = memberOffset(&VertexBaseComponents::normal);
+
+    return layout;
+}
+
+inline OBJReader::Layout VertexComponentsColored::layout() {
+    OBJReader::Layout layout = VertexBaseComponents::layout();
+    layout.color.offset = memberOffset(&VertexComponentsColored::color);
+    layout.uv.offset = memberOffset(&VertexComponentsColored::uv);
+
+    return layout;
+}
+
+
 template <typename TVertexComponents>
 class Vertex {
     static_assert(std::is_base_of<VertexComponents, TVertexComponents>::value,
                        "Class type has to be derived from VertexComponents class");
+    static_assert(std::is_trivially_copyable<TVertexComponents>::value,
+                       "Vertex components are copied as plain memory");
 
 public:
 
@@ -72,6 +149,149 @@ public:
 using MeshVertex = Vertex<VertexBaseComponents>;
 
 
+//
+// Vertex storage policies of Mesh, channels and whole vertices are reached by index
+// through them. VertexArray keeps whole vertices in one array, as OBJReader, the GPU
+// upload and ProgressiveMesh use them. VertexStreams keeps every channel of the layout
+// in an array of its own, so kernels over positions or normals only read those.
+// Channels outside the layout are not kept.
+//
+template <typename TVertexComponents>
+struct VertexArray {
+    using VertexType = Vertex<TVertexComponents>;
+    using Container = std::vector<VertexType>;
+
+    static glm::vec3 &position(Container &vertices, size_t i) {
+        return vertices[i].components.position;
+    }
+
+    static glm::vec3 const &position(Container const &vertices, size_t i) {
+        return vertices[i].components.position;
+    }
+
+    static glm::vec3 &normal(Container &vertices, size_t i) {
+        return vertices[i].components.normal;
+    }
+
+    static glm::vec3 const &normal(Container const &vertices, size_t i) {
+        return vertices[i].components.normal;
+    }
+
+    static VertexType get(Container const &vertices, size_t i) {
+        return vertices[i];
+    }
+
+    static void set(Container &vertices, size_t i, VertexType const &vertex) {
+        vertices[i] = vertex;
+    }
+
+    static void assign(Container &vertices, std::vector<VertexType> source) {
+        vertices = std::move(source);
+    }
+};
+
+
+template <typename TVertexComponents>
+struct VertexStreams {
+    using VertexType = Vertex<TVertexComponents>;
+
+    static OBJReader::Layout const &layout() {
+        static const OBJReader::Layout layout = TVertexComponents::layout();
+        return layout;
+    }
+
+    // colours and uvs stay empty when the layout has none
+    struct Container {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec4> colors;
+        std::vector<glm::vec2> uvs;
+
+        size_t size() const {
+            return positions.size();
+        }
+
+        bool empty() const {
+            return positions.empty();
+        }
+
+        void resize(size_t size) {
+            positions.resize(size);
+            normals.resize(size);
+            if (layout().color.offset != -1) colors.resize(size);
+            if (layout().uv.offset != -1) uvs.resize(size);
+        }
+
+        void reserve(size_t size) {
+            positions.reserve(size);
+            normals.reserve(size);
+            if (layout().color.offset != -1) colors.reserve(size);
+            if (layout().uv.offset != -1) uvs.reserve(size);
+        }
+
+        void clear() {
+            positions.clear();
+            normals.clear();
+            colors.clear();
+            uvs.clear();
+        }
+
+        void push_back(VertexType const &vertex) {
+            resize(size() + 1);
+            set(*this, size() - 1, vertex);
+        }
+    };
+
+    static glm::vec3 &position(Container &vertices, size_t i) {
+        return vertices.positions[i];
+    }
+
+    static glm::vec3 const &position(Container const &vertices, size_t i) {
+        return vertices.positions[i];
+    }
+
+    static glm::vec3 &normal(Container &vertices, size_t i) {
+        return vertices.normals[i];
+    }
+
+    static glm::vec3 const &normal(Container const &vertices, size_t i) {
+        return vertices.normals[i];
+    }
+
+    static VertexType get(Container const &vertices, size_t i) {
+        VertexType vertex{};
+        auto *bytes = reinterpret_cast<uchar *>(&vertex.components);
+
+        vertex.components.position = vertices.positions[i];
+        vertex.components.normal = vertices.normals[i];
+
+        if (layout().color.offset != -1) memcpy(bytes + layout().color.offset, &vertices.colors[i], sizeof(glm::vec4));
+        if (layout().uv.offset != -1) memcpy(bytes + layout().uv.offset, &vertices.uvs[i], sizeof(glm::vec2));
+
+        return vertex;
+    }
+
+    static void set(Container &vertices, size_t i, VertexType const &vertex) {
+        auto const *bytes = reinterpret_cast<uchar const *>(&vertex.components);
+
+        vertices.positions[i] = vertex.components.position;
+        vertices.normals[i] = vertex.components.normal;
+
+        if (layout().color.offset != -1) memcpy(&vertices.colors[i], bytes + layout().color.offset, sizeof(glm::vec4));
+        if (layout().uv.offset != -1) memcpy(&vertices.uvs[i], bytes + layout().uv.offset, sizeof(glm::vec2));
+    }
+
+    static void assign(Container &vertices, std::vector<VertexType> const &source) {
+        vertices.clear();
+        vertices.resize(source.size());
+
+        for (size_t i = 0; i < source.size(); i++) {
+            set(vertices, i, source[i]);
+        }
+    }
+};
+
+
 struct Face {
     uint v0;
     uint v1;
@@ -83,142 +303,444 @@ struct Face {
 };
 
 
-template <typename TVertexComponents>
+template <typename TVertexComponents, typename TStorage = VertexArray<TVertexComponents>>
 class Mesh;
 
+template <typename TVertexComponents>
+class ProgressiveMesh;
+
 
 namespace Simplify {
     struct Vertex;
+    struct Context;
+    struct StreamOptions;
 
     template <class T>
-    void simplify_mesh(T *mesh, int target_count, double agressiveness);
+    void simplify_mesh(Context &ctx, T *mesh, int target_count, double agressiveness);
     template <class T>
-    void compact_mesh(T *mesh);
+    void compact_mesh(Context &ctx, T *mesh);
     template <typename T>
-    void update_triangles(T *mesh, int i0,Vertex &v,std::vector<int> &deleted,int &deleted_triangles);
+    void update_triangles(Context &ctx, T *mesh, int i0,int i1,Vertex &v,std::vector<int> &deleted,int &deleted_triangles,int &last);
+    template <typename T>
+    bool simplify_file(std::string const &input, std::string const &output, float ratio, StreamOptions const &options);
 }
 
 
 
-template <class TVertexComponents>
+template <class TVertexComponents, class TStorage>
 class Mesh {
 protected:
-    std::vector<Vertex<TVertexComponents>> m_vertices;
+    typename TStorage::Container m_vertices;
     std::vector<Face> m_faces;
 
+    Simplify::Method m_simplify_method = Simplify::Method::Threshold;
+    float m_attribute_weight = 0.f;
+    Simplify::Schedule m_threshold_schedule = Simplify::Schedule::Fixed;
+    unsigned int m_threads = 0;
+    Simplify::Progress *m_progress = nullptr;
+    Simplify::Stats m_stats;
+
+    // workers of the area, volume and normal kernels, not shared with copies of the mesh
+    mutable LazyThreadPool m_pool;
+
 public:
-    template <class T>
-    friend void Simplify::simplify_mesh(Mesh<T> *mesh, int target_count, double agressiveness);
-    template <class T>
-    friend void Simplify::compact_mesh(Mesh<T> *mesh);
+    template <class T, class S>
+    friend void Simplify::simplify_mesh(Simplify::Context &ctx, Mesh<T, S> *mesh, int target_count, double agressiveness);
+    template <class T, class S>
+    friend void Simplify::copy_level(Simplify::Context &ctx, Mesh<T, S> *mesh, Mesh<T, S> &level);
+    template <class T, class S>
+    friend void Simplify::simplify_mesh_levels(Simplify::Context &ctx, Mesh<T, S> *mesh, std::vector<int> const &targets, std::vector<Mesh<T, S>> *levels, double agressiveness);
+    template <class T, class S>
+    friend void Simplify::simplify_mesh_heap_levels(Simplify::Context &ctx, Mesh<T, S> *mesh, std::vector<int> const &targets, std::vector<Mesh<T, S>> *levels);
+    template <class T, class S>
+    friend void Simplify::compact_mesh(Simplify::Context &ctx, Mesh<T, S> *mesh);
+    template <class T, class S>
+    friend void Simplify::update_triangles(Simplify::Context &ctx, Mesh<T, S> *mesh, int i0,int i1,Vertex &v,std::vector<int> &deleted,int &deleted_triangles,int &last);
+    template <class T, class S>
+    friend void Simplify::collapse_attributes(Simplify::Context &ctx, Mesh<T, S> *mesh, int i0, int i1, float *attributes);
+    template <class T, class S>
+    friend void Simplify::import_attributes(Simplify::Context &ctx, Mesh<T, S> *mesh);
+    template <class T, class S>
+    friend void Simplify::collapse_edge(Simplify::Context &ctx, Mesh<T, S> *mesh, int i0, int i1, Simplify::vec3f const &p, int &deleted_triangles, Simplify::Scratch &scratch);
+    template <class T, class S>
+    friend void Simplify::import_mesh(Simplify::Context &ctx, Mesh<T, S> *mesh);
+    template <class T, class S>
+    friend void Simplify::simplify_mesh_heap(Simplify::Context &ctx, Mesh<T, S> *mesh, int target_count);
+    template <class T, class S>
+    friend void Simplify::simplify_mesh_partitioned(Simplify::Context &ctx, Mesh<T, S> *mesh, int target_count, double agressiveness);
+    template <class T, class S>
+    friend void Simplify::simplify_mesh_clustering(Simplify::Context &ctx, Mesh<T, S> *mesh, int target_count);
+    template <class T, class S>
+    friend void Simplify::simplify_mesh_parallel_levels(Simplify::Context &ctx, Mesh<T, S> *mesh, std::vector<int> const &targets, std::vector<Mesh<T, S>> *levels, double agressiveness);
     template <typename T>
-    friend void Simplify::update_triangles(Mesh<T> *mesh, int i0,Vertex &v,std::vector<int> &deleted,int &deleted_triangles);
+    friend bool Simplify::simplify_file(std::string const &input, std::string const &output, float ratio, Simplify::StreamOptions const &options);
 
-    using VertexType = Vertex<TVertexComponents>;
+    friend class ProgressiveMesh<TVertexComponents>;
 
-    static OBJReader::Layout layoutDefault;
+    using VertexType = Vertex<TVertexComponents>;
 
 public:
-    Mesh() {
-        Mesh<TVertexComponents>::layoutDefault.position.offset = static_cast<uint>(offsetof(TVertexComponents, position));
-    }
     virtual ~Mesh() {}
 
     virtual void load_from_file(std::string const &fileName) {
-        OBJReader::Layout layout;
-        layout.position.offset = 0;
-        layout.color.offset = 24;
-        layout.uv.offset = 40;
-
-        m_vertices.clear();
+        std::vector<VertexType> vertices;
         m_faces.clear();
 
-        OBJReader::read(fileName, m_vertices, m_faces, layout);
+        OBJReader::read(fileName, vertices, m_faces, TVertexComponents::layout());
+        TStorage::assign(m_vertices, std::move(vertices));
     }
 
-    std::vector<Vertex<TVertexComponents>> const &vertices() const {
+    // Write positions, colours and face corner uvs as OBJ
+
+    bool save_to_file(std::string const &fileName) const;
+
+    typename TStorage::Container const &vertices() const {
         return m_vertices;
     }
 
+    // Channels and whole vertices by index, for any storage
+
+    uint vertex_count() const {
+        return static_cast<uint>(m_vertices.size());
+    }
+
+    glm::vec3 const &position(uint i) const {
+        return TStorage::position(m_vertices, i);
+    }
+
+    glm::vec3 const &normal(uint i) const {
+        return TStorage::normal(m_vertices, i);
+    }
+
+    VertexType vertex(uint i) const {
+        return TStorage::get(m_vertices, i);
+    }
+
     std::vector<Face> const &faces() const {
         return m_faces;
     }
 
-    float area() const {
-        float _area = 0.f;
+    // Sums over the faces on m_threads threads, the partial sums are compensated
 
-        for (uint i = 0; i < m_faces.size(); i++) {
-            _area += triangle_area(i);
-        }
+    float area() const {
+        return static_cast<float>(face_sum([this](Face const &face) {
+            glm::vec3 const &_vp0 = position(face.v0);
+            return 0.5f * glm::length(glm::cross(position(face.v1) - _vp0, position(face.v2) - _vp0));
+        }));
     }
 
     float volume() const {
-        float _volume = 0.0f;
-
-        for (auto const &face : m_faces) {
-            _volume += tetrahedronSignedVolume(
-                    m_vertices.at(face.v0).components.position,
-                    m_vertices.at(face.v1).components.position,
-                    m_vertices.at(face.v2).components.position
-            );
-        }
+        // six times the signed volume of the tetrahedron with the origin per face
+        return static_cast<float>(face_sum([this](Face const &face) {
+            return glm::dot(position(face.v0), glm::cross(position(face.v1), position(face.v2)));
+        }) / 6.0);
+    }
+
+    void set_simplify_method(Simplify::Method method) {
+        m_simplify_method = method;
+    }
+
+    Simplify::Method simplify_method() const {
+        return m_simplify_method;
+    }
+
+    // Weight of colour and uv against position in the error, 0 simplifies by position only
+
+    void set_attribute_weight(float weight) {
+        m_attribute_weight = weight;
+    }
+
+    float attribute_weight() const {
+        return m_attribute_weight;
+    }
+
+    // Growth of the collapse threshold of the threshold, partitioned and parallel methods
+
+    void set_threshold_schedule(Simplify::Schedule schedule) {
+        m_threshold_schedule = schedule;
+    }
+
+    Simplify::Schedule threshold_schedule() const {
+        return m_threshold_schedule;
+    }
+
+    // Worker threads of the parallel passes, 0 means one per hardware thread
+
+    void set_threads(unsigned int threads) {
+        m_threads = threads;
+    }
+
+    unsigned int threads() const {
+        return m_threads;
+    }
+
+    // Progress of the following runs is published here and they can be cancelled through it
 
-        return _volume;
+    void set_progress(Simplify::Progress *progress) {
+        m_progress = progress;
+    }
+
+    // Timings and counters of the last simplification
+
+    Simplify::Stats const &stats() const {
+        return m_stats;
+    }
+
+    // Replace the geometry, e.g. with a copy simplified on another thread
+
+    virtual void assign(std::vector<VertexType> vertices, std::vector<Face> faces) {
+        TStorage::assign(m_vertices, std::move(vertices));
+        m_faces = std::move(faces);
     }
 
     virtual void simplify(float p = 0.5f);
     virtual void simplify(uint verticesFinalCount);
 
+    // Simplify until every collapse left would exceed max_error, returns the face count reached.
+    // Clustering has no edge errors to bound, the mesh is left as it is then.
+    virtual uint simplify_to_error(double max_error, Simplify::ErrorBound bound = Simplify::ErrorBound::Distance);
+
+    //
+    // LOD chain from one run: a copy of the mesh at every ratio of the current face count,
+    // in descending order. Every level goes on from the one before, the mesh ends at the last.
+    //
+    virtual std::vector<Mesh<TVertexComponents, TStorage>> simplify_chain(std::vector<float> const &ratios);
+
     void calculate_normals();
 
+protected:
+    void set_vertex(uint i, VertexType const &vertex) {
+        TStorage::set(m_vertices, i, vertex);
+    }
+
+    Simplify::Context make_context() const;
+    void run_simplify(Simplify::Context &context, uint verticesFinalCount);
+
 private:
-    float triangle_area(uint i) const {
-        auto &triangle = m_faces.at(i);
+    template <typename TFunc>
+    double face_sum(TFunc func) const {
+        std::vector<KahanSum> sums(thread_count(m_threads));
+
+        parallel_for(m_pool.get(m_threads), 0, static_cast<int>(m_faces.size()), [&](unsigned int thread, int begin, int end) {
+            KahanSum sum;
+
+            for (int i = begin; i < end; i++) {
+                sum.add(func(m_faces[i]));
+            }
 
-        auto const &_vp0 = m_vertices.at(triangle.v0).components.position;
-        auto const &_vp1 = m_vertices.at(triangle.v1).components.position;
-        auto const &_vp2 = m_vertices.at(triangle.v2).components.position;
+            sums[thread] = sum;
+        });
 
-        return 0.5f * glm::length(glm::cross(_vp1 - _vp0, _vp2 - _vp0));
+        KahanSum total;
+
+        for (auto const &sum : sums) {
+            total.add(sum.sum);
+            total.add(sum.compensation);
+        }
+
+        return total.value();
     }
 };
 
 
-template <typename T>
-OBJReader::Layout Mesh<T>::layoutDefault;
+//
+// Normals are gathered rather than scattered: the face normals are computed once, then
+// every vertex sums those of its faces from a vertex to face table (CSR) and writes only
+// its own normal. The faces of a vertex are listed in face order, so every normal is the
+// sum a serial pass makes, whatever the thread count or the order of the faces.
+//
+template <typename T, typename S>
+void Mesh<T, S>::calculate_normals() {
+    int face_count = static_cast<int>(m_faces.size());
+    int vertex_count = static_cast<int>(m_vertices.size());
 
+    ThreadPool &pool = m_pool.get(m_threads);
 
-template <typename T>
-void Mesh<T>::calculate_normals() {
-    for (auto &vertex : m_vertices) {
-        vertex.components.normal = glm::vec3(0.f);
-    }
+    std::vector<glm::vec3> face_normals(face_count);
+
+    parallel_for(pool, 0, face_count, [&](unsigned int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            Face const &face = m_faces[i];
 
-    for (auto &face : m_faces) {
-        glm::vec3 A = m_vertices.at(face.v1).components.position - m_vertices.at(face.v0).components.position;
-        glm::vec3 B = m_vertices.at(face.v2).components.position - m_vertices.at(face.v0).components.position;
+            glm::vec3 A = position(face.v1) - position(face.v0);
+            glm::vec3 B = position(face.v2) - position(face.v0);
 
-        glm::vec3 N = glm::normalize(glm::cross(A, B));
+            face_normals[i] = glm::normalize(glm::cross(A, B));
+        }
+    });
+
+    // faces of vertex v are incident[offsets[v], offsets[v + 1]), a face once per corner
+    std::vector<int> offsets(vertex_count + 1, 0);
+    std::vector<int> incident(3 * static_cast<size_t>(face_count));
 
-        m_vertices.at(face.v0).components.normal += N;
-        m_vertices.at(face.v1).components.normal += N;
-        m_vertices.at(face.v2).components.normal += N;
+    for (auto const &face : m_faces) {
+        offsets[face.v0 + 1]++;
+        offsets[face.v1 + 1]++;
+        offsets[face.v2 + 1]++;
     }
 
-    for (auto &vertex : m_vertices) {
-        vertex.components.normal = glm::normalize(vertex.components.normal);
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    {
+        std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+
+        for (int i = 0; i < face_count; i++) {
+            Face const &face = m_faces[i];
+
+            incident[cursor[face.v0]++] = i;
+            incident[cursor[face.v1]++] = i;
+            incident[cursor[face.v2]++] = i;
+        }
     }
+
+    parallel_for(pool, 0, vertex_count, [&](unsigned int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            glm::vec3 normal(0.f);
+
+            for (int k = offsets[i]; k < offsets[i + 1]; k++) {
+                normal += face_normals[incident[k]];
+            }
+
+            S::normal(m_vertices, i) = glm::normalize(normal);
+        }
+    });
 }
 
 
-template <typename T>
-void Mesh<T>::simplify(float p) {
+template <typename T, typename S>
+void Mesh<T, S>::simplify(float p) {
     simplify(static_cast<uint>(p * m_faces.size()));
 }
 
-template <typename T>
-void Mesh<T>::simplify(uint verticesFinalCount) {
-    Simplify::simplify_mesh<T>(this, verticesFinalCount, 7);
+template <typename T, typename S>
+void Mesh<T, S>::simplify(uint verticesFinalCount) {
+    Simplify::Context context = make_context();
+
+    run_simplify(context, verticesFinalCount);
+
+    m_stats = context.stats;
+}
+
+template <typename T, typename S>
+uint Mesh<T, S>::simplify_to_error(double max_error, Simplify::ErrorBound bound) {
+    Simplify::Context context = make_context();
+
+    // the quadric error sums squared distances to planes, each of them is at most the bound
+    context.max_error = bound == Simplify::ErrorBound::Distance ? max_error * max_error : max_error;
+
+    if (m_simplify_method == Simplify::Method::Clustering) {
+        printf("%s - clustering has no edge errors to bound, choose an edge collapse method\n", __FUNCTION__);
+        m_stats = Simplify::Stats();
+
+        return static_cast<uint>(m_faces.size());
+    }
+
+    run_simplify(context, 0);
+
+    m_stats = context.stats;
+
+    printf("%s - %d triangles within %g\n", __FUNCTION__, static_cast<int>(m_faces.size()), max_error);
+
+    return static_cast<uint>(m_faces.size());
+}
+
+template <typename T, typename S>
+std::vector<Mesh<T, S>> Mesh<T, S>::simplify_chain(std::vector<float> const &ratios) {
+    Simplify::Context context = make_context();
+
+    std::vector<int> targets;
+
+    for (float ratio : ratios) {
+        targets.push_back(static_cast<int>(ratio * m_faces.size()));
+    }
+
+    std::vector<Mesh<T, S>> levels;
+
+    // the partitioned and clustering modes can't go on from a previous level, they chain with the sweep
+    if (m_simplify_method == Simplify::Method::Heap) {
+        Simplify::simplify_mesh_heap_levels<T>(context, this, targets, &levels);
+    }
+    else if (m_simplify_method == Simplify::Method::Parallel) {
+        Simplify::simplify_mesh_parallel_levels<T>(context, this, targets, &levels, 7);
+    }
+    else {
+        Simplify::simplify_mesh_levels<T>(context, this, targets, &levels, 7);
+    }
+
+    m_stats = context.stats;
+
+    return levels;
+}
+
+template <typename T, typename S>
+bool Mesh<T, S>::save_to_file(std::string const &fileName) const {
+    std::ofstream fout(fileName);
+
+    if (!fout.is_open()) {
+        return false;
+    }
+
+    for (uint i = 0; i < m_vertices.size(); i++) {
+        VertexType vertex = S::get(m_vertices, i);
+        auto const &p = vertex.components.position;
+        float a[T::attribute_count + 1];
+
+        fout << "v " << p.x << " " << p.y << " " << p.z;
+
+        // colour channels come first, like OBJReader reads them
+        vertex.components.get_attributes(a);
+
+        for (int k = 0; k < T::attribute_count && k != T::uv_attribute; k++) {
+            fout << " " << a[k];
+        }
+
+        fout << "\n";
+    }
+
+    // one uv per face corner, seams stay as they are
+    for (auto const &face : m_faces) {
+        fout << "vt " << face.uv0.x << " " << face.uv0.y << "\n";
+        fout << "vt " << face.uv1.x << " " << face.uv1.y << "\n";
+        fout << "vt " << face.uv2.x << " " << face.uv2.y << "\n";
+    }
+
+    for (uint i = 0; i < m_faces.size(); i++) {
+        auto const &face = m_faces[i];
+
+        fout << "f " << face.v0 + 1 << "/" << 3 * i + 1 << " " << face.v1 + 1 << "/" << 3 * i + 2 << " " << face.v2 + 1 << "/" << 3 * i + 3 << "\n";
+    }
+
+    return true;
+}
+
+template <typename T, typename S>
+Simplify::Context Mesh<T, S>::make_context() const {
+    Simplify::Context context;
+    context.threads = m_threads;
+    context.attribute_weight = m_attribute_weight;
+    context.schedule = m_threshold_schedule;
+    context.progress = m_progress;
+
+    return context;
+}
+
+template <typename T, typename S>
+void Mesh<T, S>::run_simplify(Simplify::Context &context, uint verticesFinalCount) {
+    if (m_simplify_method == Simplify::Method::Heap) {
+        Simplify::simplify_mesh_heap<T>(context, this, verticesFinalCount);
+    }
+    else if (m_simplify_method == Simplify::Method::Partitioned) {
+        Simplify::simplify_mesh_partitioned<T>(context, this, verticesFinalCount, 7);
+    }
+    else if (m_simplify_method == Simplify::Method::Clustering) {
+        Simplify::simplify_mesh_clustering<T>(context, this, verticesFinalCount);
+    }
+    else if (m_simplify_method == Simplify::Method::Parallel) {
+        Simplify::simplify_mesh_parallel<T>(context, this, verticesFinalCount, 7);
+    }
+    else {
+        Simplify::simplify_mesh<T>(context, this, verticesFinalCount, 7);
+    }
 }
 
 #endif //MESHSIMPLIFICATION_MESH_H
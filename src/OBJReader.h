@@ -183,21 +183,23 @@ public:
 
                 switch (fieldType) {
                     case FieldType::Vertex: {
-                        TVertex vertex;
+                        TVertex vertex{};
 
-                        glm::vec4 default_color{1.f, 1.f, 1.f, 1.f};
-                        memcpy(reinterpret_cast<unsigned char *>(&vertex) + layout.color.offset + sizeof(unsigned long), glm::value_ptr(default_color), sizeof(default_color));
+                        if (layout.color.offset != -1) {
+                            glm::vec4 default_color{1.f, 1.f, 1.f, 1.f};
+                            memcpy(reinterpret_cast<unsigned char *>(&vertex) + layout.color.offset, glm::value_ptr(default_color), sizeof(default_color));
+                        }
 
                         std::vector<std::string> str_list = string_split(line, " \t\r", 2, false);
 
                         for (unsigned int i = 0; i < str_list.size(); i++) {
                             if (i < 3) { // vertex position
                                 float value = std::stof(str_list.at(i));
-                                memcpy(reinterpret_cast<unsigned char *>(&vertex) + layout.position.offset + i * sizeof(float) + sizeof(unsigned long), &value,
+                                memcpy(reinterpret_cast<unsigned char *>(&vertex) + layout.position.offset + i * sizeof(float), &value,
                                        sizeof(value));
                             } else if (layout.color.offset != -1) {
                                 float value = std::stof(str_list.at(i));
-                                memcpy(reinterpret_cast<unsigned char *>(&vertex) + layout.color.offset + (i - 3) * sizeof(float) + sizeof(unsigned long), &value,
+                                memcpy(reinterpret_cast<unsigned char *>(&vertex) + layout.color.offset + (i - 3) * sizeof(float), &value,
                                        sizeof(value));
                             }
                         }
@@ -217,7 +219,7 @@ public:
                         break;
                     }
                     case FieldType::Face: {
-                        TFace face;
+                        TFace face{};
 
                         std::vector<std::string> str_list = string_split(line, " \t\r", 2, false);
 
@@ -231,8 +233,9 @@ public:
                                 uint uv_id = std::stoul(face_components.at(1)) - 1;
                                 glm::vec2 uv = tv.at(uv_id);
 
-                                memcpy(reinterpret_cast<unsigned char *>(vertices.data() + value) + layout.uv.offset + sizeof(unsigned long), &uv,
-                                       sizeof(uv));
+                                if (layout.uv.offset != -1) {
+                                    memcpy(reinterpret_cast<unsigned char *>(vertices.data() + value) + layout.uv.offset, &uv, sizeof(uv));
+                                }
 
                                 memcpy(reinterpret_cast<unsigned char *>(&face) + 3 * sizeof(uint) + i * sizeof(glm::vec2), &uv, sizeof(uv));
                             }
@@ -277,6 +280,74 @@ public:
         }
     }
 
+    //
+    // Parse fileName line by line without storing anything, for files that do not fit
+    // in memory. Calls on_vertex(position, color, has_color), on_uv(uv) and
+    // on_face(v, uv) with zero based ids, uv[i] is -1 when a corner has none.
+    //
+    template <typename TOnVertex, typename TOnUV, typename TOnFace>
+    static bool stream(std::string const &fileName, TOnVertex on_vertex, TOnUV on_uv, TOnFace on_face) {
+        std::ifstream fin(fileName);
+
+        if (!fin.is_open()) {
+            return false;
+        }
+
+        std::string line;
+
+        while (std::getline(fin, line)) {
+            FieldType fieldType = get_field_type(line);
+
+            switch (fieldType) {
+                case FieldType::Vertex: {
+                    glm::vec3 position{0.f};
+                    glm::vec4 color{1.f, 1.f, 1.f, 1.f};
+
+                    std::vector<std::string> str_list = string_split(line, " \t\r", 2, false);
+
+                    for (unsigned int i = 0; i < str_list.size() && i < 7; i++) {
+                        float value = std::stof(str_list.at(i));
+
+                        if (i < 3) position[i] = value;
+                        else color[i - 3] = value;
+                    }
+
+                    on_vertex(position, color, str_list.size() > 3);
+
+                    break;
+                }
+                case FieldType::UV: {
+                    std::vector<std::string> str_list = string_split(line, " \t\r", 3, false);
+
+                    on_uv(glm::vec2{std::stof(str_list.at(0)), std::stof(str_list.at(1))});
+
+                    break;
+                }
+                case FieldType::Face: {
+                    uint v[3];
+                    int uv[3];
+
+                    std::vector<std::string> str_list = string_split(line, " \t\r", 2, false);
+
+                    for (unsigned int i = 0; i < 3; i++) {
+                        std::vector<std::string> face_components = string_split(str_list.at(i), "/", 0);
+
+                        v[i] = static_cast<unsigned int>(std::stoul(face_components.at(0))) - 1;
+                        uv[i] = face_components.size() > 1 && face_components.at(1).length() != 0 ? std::stoi(face_components.at(1)) - 1 : -1;
+                    }
+
+                    on_face(v, uv);
+
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+
+        return true;
+    }
+
 private:
     static FieldType get_field_type(std::string const &line) {
         bool is_comment = line.find('#') != std::string::npos;
@@ -0,0 +1,247 @@
+#ifndef MESHSIMPLIFICATION_PROGRESSIVEMESH_H
+#define MESHSIMPLIFICATION_PROGRESSIVEMESH_H
+
+#include <algorithm>
+#include <vector>
+
+#include "Mesh.h"
+#include "Simplify.h"
+
+
+//
+// Progressive mesh: the full collapse sequence of a mesh, recorded once with the
+// priority queue simplifier. Any level is reached from the current one by replaying
+// or undoing collapses, which only touches the vertices and corners they changed.
+//
+// Faces are stored in reverse order of removal, so the faces of every level are a
+// prefix of m_faces and a level change never moves a face.
+//
+template <typename TVertexComponents>
+class ProgressiveMesh {
+    using VertexType = Vertex<TVertexComponents>;
+
+    struct Level {
+        uint v0;
+        uint v1;
+        uint corners_begin;
+        uint corners_end;
+        uint face_count;    // faces left once the collapse is applied
+    };
+
+    std::vector<VertexType> m_vertices;
+    std::vector<Face> m_faces;
+
+    std::vector<Level> m_levels;
+    std::vector<uint> m_corners;            // face * 3 + corner, indexing m_faces
+    std::vector<VertexType> m_before;       // v0 before each collapse
+    std::vector<VertexType> m_after;        // v0 after each collapse
+
+    uint m_level = 0;
+
+public:
+    void clear() {
+        m_vertices.clear();
+        m_faces.clear();
+        m_levels.clear();
+        m_corners.clear();
+        m_before.clear();
+        m_after.clear();
+        m_level = 0;
+    }
+
+    bool empty() const {
+        return m_faces.empty();
+    }
+
+    // Number of collapses applied, 0 is the recorded mesh
+
+    uint level() const {
+        return m_level;
+    }
+
+    uint levels() const {
+        return static_cast<uint>(m_levels.size());
+    }
+
+    uint face_count() const {
+        return face_count(m_level);
+    }
+
+    uint max_face_count() const {
+        return face_count(0);
+    }
+
+    uint min_face_count() const {
+        return face_count(levels());
+    }
+
+    // Runs on the threads and reports to the progress of mesh, a cancelled run keeps
+    // only the collapses made until then
+
+    void record(Mesh<TVertexComponents> &mesh);
+
+    // Go to the coarsest level with at most face_count faces
+
+    void set_face_count(uint face_count);
+    void set_level(uint level);
+
+    // Write the current level to mesh, vertices that are not referenced are dropped
+
+    void extract(Mesh<TVertexComponents> &mesh) const;
+
+private:
+    uint face_count(uint level) const {
+        return level == 0 ? static_cast<uint>(m_faces.size()) : m_levels[level - 1].face_count;
+    }
+
+    uint &corner(uint c) {
+        return *(&m_faces[c / 3].v0 + c % 3);
+    }
+};
+
+
+template <typename T>
+void ProgressiveMesh<T>::record(Mesh<T> &mesh) {
+    clear();
+
+    m_vertices = mesh.m_vertices;
+    m_faces = mesh.m_faces;
+
+    Simplify::Record record;
+    Simplify::Context context;
+    context.record = &record;
+    context.threads = mesh.m_threads;
+    context.progress = mesh.m_progress;
+
+    // the simplifier works on the mesh in place, it is restored right after
+    Simplify::simplify_mesh_heap<T>(context, &mesh, 0);
+
+    mesh.m_vertices = m_vertices;
+    mesh.m_faces = m_faces;
+
+    // faces that are never removed come first, then the faces of the last collapse and so on
+
+    uint total = static_cast<uint>(m_faces.size());
+    uint removed = static_cast<uint>(record.faces.size());
+
+    std::vector<uint> position(total, 0);
+    std::vector<char> is_removed(total, 0);
+
+    for (int face : record.faces) {
+        is_removed[face] = 1;
+    }
+
+    uint dst = 0;
+
+    for (uint i = 0; i < total; i++) {
+        if (!is_removed[i]) {
+            position[i] = dst++;
+        }
+    }
+
+    for (uint i = removed; i > 0; i--) {
+        position[record.faces[i - 1]] = dst++;
+    }
+
+    std::vector<Face> faces(total);
+
+    for (uint i = 0; i < total; i++) {
+        faces[position[i]] = m_faces[i];
+    }
+
+    m_faces = std::move(faces);
+
+    // levels, corners and vertex states, replaying the interpolation of collapse_edge
+
+    m_levels.reserve(record.collapses.size());
+    m_before.reserve(record.collapses.size());
+    m_after.reserve(record.collapses.size());
+    m_corners.reserve(record.corners.size());
+
+    std::vector<VertexType> vertices = m_vertices;
+    uint corners_begin = 0;
+
+    for (auto const &collapse : record.collapses) {
+        for (int c = static_cast<int>(corners_begin); c < collapse.corners_end; c++) {
+            m_corners.push_back(position[record.corners[c] / 3] * 3 + record.corners[c] % 3);
+        }
+
+        auto &v0 = vertices.at(collapse.v0);
+
+        m_before.push_back(v0);
+        v0.components.interpolate(v0.components, vertices.at(collapse.v1).components, collapse.t);
+        m_after.push_back(v0);
+
+        m_levels.push_back(Level{static_cast<uint>(collapse.v0), static_cast<uint>(collapse.v1),
+                                 corners_begin, static_cast<uint>(collapse.corners_end),
+                                 total - static_cast<uint>(collapse.faces_end)});
+
+        corners_begin = static_cast<uint>(collapse.corners_end);
+    }
+}
+
+template <typename T>
+void ProgressiveMesh<T>::set_face_count(uint face_count) {
+    // face counts only decrease with the level
+    auto it = std::partition_point(m_levels.begin(), m_levels.end(), [face_count](Level const &l) {
+        return l.face_count > face_count;
+    });
+
+    // the collapse found is the first one that fits, level 0 when the full mesh already does
+    uint level = face_count >= max_face_count() ? 0 : static_cast<uint>(it - m_levels.begin()) + 1;
+
+    set_level(level);
+}
+
+template <typename T>
+void ProgressiveMesh<T>::set_level(uint level) {
+    level = std::min(level, levels());
+
+    while (m_level < level) {
+        Level const &l = m_levels[m_level];
+
+        m_vertices[l.v0] = m_after[m_level];
+
+        for (uint c = l.corners_begin; c < l.corners_end; c++) {
+            corner(m_corners[c]) = l.v0;
+        }
+
+        m_level++;
+    }
+
+    while (m_level > level) {
+        m_level--;
+
+        Level const &l = m_levels[m_level];
+
+        m_vertices[l.v0] = m_before[m_level];
+
+        for (uint c = l.corners_begin; c < l.corners_end; c++) {
+            corner(m_corners[c]) = l.v1;
+        }
+    }
+}
+
+template <typename T>
+void ProgressiveMesh<T>::extract(Mesh<T> &mesh) const {
+    std::vector<int> remap(m_vertices.size(), -1);
+
+    mesh.m_vertices.clear();
+    mesh.m_faces.assign(m_faces.begin(), m_faces.begin() + face_count());
+
+    for (auto &face : mesh.m_faces) {
+        for (uint j = 0; j < 3; j++) {
+            uint &v = *(&face.v0 + j);
+
+            if (remap[v] < 0) {
+                remap[v] = static_cast<int>(mesh.m_vertices.size());
+                mesh.m_vertices.push_back(m_vertices[v]);
+            }
+
+            v = static_cast<uint>(remap[v]);
+        }
+    }
+}
+
+
+#endif //MESHSIMPLIFICATION_PROGRESSIVEMESH_H
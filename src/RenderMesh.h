@@ -3,6 +3,7 @@
 
 #include <chrono>
 #include "Mesh.h"
+#include "ProgressiveMesh.h"
 #include "./gl/Buffer.h"
 #include "./gl/Texture.h"
 #include "Shader.h"
@@ -10,12 +11,8 @@
 
 template <typename TVertexComponents>
 class RenderMesh : public Mesh<TVertexComponents> {
-    struct VertexBuffer {
-        uint position_desc;
-        uint normal_desc;
-        uint color_desc;
-        uint uv_desc;
-    } vertexBuffer;
+    // the vertices as they are, the attributes point at their offsets
+    uint m_vertex_buffer;
 
     struct RenderGroup {
         uint face_id0;
@@ -43,12 +40,15 @@ class RenderMesh : public Mesh<TVertexComponents> {
     std::vector<uint> m_indices;
     std::vector<FaceNativeData> m_face_native_data;
 
+    ProgressiveMesh<TVertexComponents> m_progressive;
+
 public:
     void load_from_file(std::string const &fileName) override {
         Mesh<TVertexComponents>::load_from_file(fileName);
         Mesh<TVertexComponents>::calculate_normals();
 
         m_vertex_count = static_cast<uint>(Mesh<TVertexComponents>::m_vertices.size());
+        m_progressive.clear();
 
         reset();
 
@@ -56,12 +56,11 @@ public:
     }
 
     void simplify(float p = 0.5f) override {
-        simplify(static_cast<uint>(p * Mesh<TVertexComponents>::m_faces.size()));
+        simplify(static_cast<uint>(p * source_face_count()));
     }
 
     void simplify(uint verticesFinalCount) override {
-        restore_faces();
-        Mesh<TVertexComponents>::m_vertices.resize(m_vertex_count);
+        restore_source();
 
         auto start = std::chrono::high_resolution_clock::now();
         Mesh<TVertexComponents>::simplify(verticesFinalCount);
@@ -71,8 +70,125 @@ public:
 
         std::cout << "algorithm duration - " << duration.count() << std::endl;
 
+        m_vertex_count = static_cast<uint>(Mesh<TVertexComponents>::m_vertices.size());
+        m_progressive.clear();
+
+        reset();
+        initMaterials(true);
+    }
+
+    uint simplify_to_error(double max_error, Simplify::ErrorBound bound = Simplify::ErrorBound::Distance) override {
+        restore_source();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        uint face_count = Mesh<TVertexComponents>::simplify_to_error(max_error, bound);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::chrono::duration<float> duration = end - start;
+
+        std::cout << "algorithm duration - " << duration.count() << std::endl;
+
+        m_vertex_count = static_cast<uint>(Mesh<TVertexComponents>::m_vertices.size());
+        m_progressive.clear();
+
         reset();
         initMaterials(true);
+
+        return face_count;
+    }
+
+    std::vector<Mesh<TVertexComponents>> simplify_chain(std::vector<float> const &ratios) override {
+        restore_source();
+
+        auto levels = Mesh<TVertexComponents>::simplify_chain(ratios);
+
+        m_vertex_count = static_cast<uint>(Mesh<TVertexComponents>::m_vertices.size());
+        m_progressive.clear();
+
+        reset();
+        initMaterials(true);
+
+        return levels;
+    }
+
+    // Faces of the mesh simplification starts from, the full mesh of a recorded sequence
+
+    uint source_face_count() const {
+        return m_progressive.empty() ? static_cast<uint>(Mesh<TVertexComponents>::m_faces.size()) : m_progressive.max_face_count();
+    }
+
+    //
+    // Copy of the mesh as simplify() would see it, without the vertices split along uv
+    // seams and at the full level of a recorded sequence. It can be simplified on another
+    // thread while this one is drawn and then be handed back to assign().
+    //
+    Mesh<TVertexComponents> simplification_source() {
+        Mesh<TVertexComponents> mesh;
+
+        if (!m_progressive.empty()) {
+            uint level = m_progressive.level();
+
+            m_progressive.set_level(0);
+            m_progressive.extract(mesh);
+            m_progressive.set_level(level);
+        }
+        else {
+            auto vertices = Mesh<TVertexComponents>::m_vertices;
+            auto faces = Mesh<TVertexComponents>::m_faces;
+
+            restore_faces(faces);
+            vertices.resize(m_vertex_count);
+
+            mesh.assign(std::move(vertices), std::move(faces));
+        }
+
+        mesh.set_simplify_method(Mesh<TVertexComponents>::simplify_method());
+        mesh.set_attribute_weight(Mesh<TVertexComponents>::attribute_weight());
+        mesh.set_threshold_schedule(Mesh<TVertexComponents>::threshold_schedule());
+        mesh.set_threads(Mesh<TVertexComponents>::threads());
+
+        return mesh;
+    }
+
+    void assign(std::vector<typename Mesh<TVertexComponents>::VertexType> vertices, std::vector<Face> faces) override {
+        Mesh<TVertexComponents>::assign(std::move(vertices), std::move(faces));
+
+        m_vertex_count = static_cast<uint>(Mesh<TVertexComponents>::m_vertices.size());
+        m_progressive.clear();
+
+        reset();
+        initMaterials(true);
+    }
+
+    // Take a collapse sequence recorded on simplification_source() and show its full
+    // level, set_lod() can then pick any level
+
+    void set_progressive(ProgressiveMesh<TVertexComponents> progressive) {
+        m_progressive = std::move(progressive);
+        m_progressive.extract(*this);
+
+        m_vertex_count = static_cast<uint>(Mesh<TVertexComponents>::m_vertices.size());
+
+        reset();
+        initMaterials(true);
+    }
+
+    void set_lod(uint faceCount) {
+        if (m_progressive.empty()) {
+            return;
+        }
+
+        m_progressive.set_face_count(faceCount);
+        m_progressive.extract(*this);
+
+        m_vertex_count = static_cast<uint>(Mesh<TVertexComponents>::m_vertices.size());
+
+        reset();
+        initMaterials(true);
+    }
+
+    ProgressiveMesh<TVertexComponents> const &progressive() const {
+        return m_progressive;
     }
 
     RenderMesh() = default;
@@ -91,14 +207,14 @@ public:
         glEnableVertexAttribArray(color_attribute);
         glEnableVertexAttribArray(uv_attribute);
 
-        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer.position_desc);
-        glVertexAttribPointer(position_attribute, 3, GL_FLOAT, GL_FALSE, sizeof(typename Mesh<TVertexComponents>::VertexType), nullptr);
-        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer.normal_desc);
-        glVertexAttribPointer(normal_attribute,   3, GL_FLOAT, GL_FALSE, sizeof(typename Mesh<TVertexComponents>::VertexType), nullptr);
-        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer.color_desc);
-        glVertexAttribPointer(color_attribute,    4, GL_FLOAT, GL_FALSE, sizeof(typename Mesh<TVertexComponents>::VertexType), nullptr);
-        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer.uv_desc);
-        glVertexAttribPointer(uv_attribute,       2, GL_FLOAT, GL_FALSE, sizeof(typename Mesh<TVertexComponents>::VertexType), nullptr);
+        OBJReader::Layout layout = TVertexComponents::layout();
+        auto stride = static_cast<GLsizei>(sizeof(typename Mesh<TVertexComponents>::VertexType));
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_vertex_buffer);
+        glVertexAttribPointer(position_attribute, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void const *>(static_cast<uintptr_t>(layout.position.offset)));
+        glVertexAttribPointer(normal_attribute,   3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void const *>(static_cast<uintptr_t>(layout.normal.offset)));
+        glVertexAttribPointer(color_attribute,    4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void const *>(static_cast<uintptr_t>(layout.color.offset)));
+        glVertexAttribPointer(uv_attribute,       2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void const *>(static_cast<uintptr_t>(layout.uv.offset)));
 
         glProgramUniform1i(shader.getId(), shader.uniformLocation("tex"), 0);
 
@@ -121,18 +237,36 @@ public:
 
 private:
     void restore_faces() {
+        restore_faces(Mesh<TVertexComponents>::m_faces);
+    }
+
+    //
+    // Undo the uv seam split before simplifying. With a recorded sequence go back to its
+    // full mesh instead, the level set_lod() shows is only a preview.
+    //
+    void restore_source() {
+        if (!m_progressive.empty()) {
+            m_progressive.set_level(0);
+            m_progressive.extract(*this);
+
+            m_vertex_count = static_cast<uint>(Mesh<TVertexComponents>::m_vertices.size());
+            return;
+        }
+
+        restore_faces();
+        Mesh<TVertexComponents>::m_vertices.resize(m_vertex_count);
+    }
+
+    void restore_faces(std::vector<Face> &faces) const {
         for (auto &face_data : m_face_native_data) {
-            memcpy(reinterpret_cast<uchar *>(Mesh<TVertexComponents>::m_faces.data() + face_data.face_id) + face_data.vertex_num * sizeof(uint),
+            memcpy(reinterpret_cast<uchar *>(faces.data() + face_data.face_id) + face_data.vertex_num * sizeof(uint),
                    &face_data.vertex_id,
                    sizeof(face_data.vertex_id));
         }
     }
 
     void reset() {
-        gl::Buffer::free(vertexBuffer.position_desc);
-        gl::Buffer::free(vertexBuffer.normal_desc);
-        gl::Buffer::free(vertexBuffer.color_desc);
-        gl::Buffer::free(vertexBuffer.uv_desc);
+        gl::Buffer::free(m_vertex_buffer);
 
         for (auto desc : m_textures) {
             gl::Texture::free(desc);
@@ -204,10 +338,7 @@ void RenderMesh<T>::initMaterials(bool copy_vertices) {
         m_indices.push_back(face.v2);
     }
 
-    vertexBuffer.position_desc = gl::Buffer::create(Mesh<T>::m_vertices.data(), Mesh<T>::m_vertices.size() * sizeof(typename Mesh<T>::VertexType), VTABLE_OFFSET);
-    vertexBuffer.normal_desc   = gl::Buffer::create(Mesh<T>::m_vertices.data(), Mesh<T>::m_vertices.size() * sizeof(typename Mesh<T>::VertexType), VTABLE_OFFSET + sizeof(glm::vec3));
-    vertexBuffer.color_desc    = gl::Buffer::create(Mesh<T>::m_vertices.data(), Mesh<T>::m_vertices.size() * sizeof(typename Mesh<T>::VertexType), VTABLE_OFFSET + 2 * sizeof(glm::vec3));
-    vertexBuffer.uv_desc       = gl::Buffer::create(Mesh<T>::m_vertices.data(), Mesh<T>::m_vertices.size() * sizeof(typename Mesh<T>::VertexType), VTABLE_OFFSET + 2 * sizeof(glm::vec3) + sizeof(glm::vec4));
+    m_vertex_buffer = gl::Buffer::create(Mesh<T>::m_vertices.data(), Mesh<T>::m_vertices.size() * sizeof(typename Mesh<T>::VertexType), 0);
 }
 
 
@@ -1,23 +1,20 @@
 #include "Simplify.h"
 #include "Mesh.h"
+#include "../common/parallel.h"
 
 
 namespace Simplify {
-    std::vector<Triangle> triangles;
-    std::vector<Vertex> vertices;
-    std::vector<Ref> refs;
-
     // Check if a triangle flips when this edge is removed
 
-    bool flipped(vec3f p,int i0,int i1,Vertex &v0,Vertex &v1,std::vector<int> &deleted)
+    bool flipped(Context &ctx, vec3f p,int i0,int i1,Vertex &v0,Vertex &v1,std::vector<int> &deleted)
     {
         int bordercount=0;
-        for (int k = 0; k < v0.tcount; k++)
+        int k=0;
+        for (int c = v0.corner; c >= 0; c = ctx.next_corner[c], k++)
         {
-            Triangle &t=triangles[refs[v0.tstart+k].tid];
-            if(t.deleted)continue;
+            Triangle &t=ctx.triangles[c/3];
 
-            int s=refs[v0.tstart+k].tvertex;
+            int s=c%3;
             int id1 = t.v[(s + 1) % 3];
             int id2 = t.v[(s + 2) % 3];
 
@@ -28,8 +25,8 @@ namespace Simplify {
                 continue;
             }
 
-            vec3f d1 = vertices[id1].p-p; d1 = glm::normalize(d1);
-            vec3f d2 = vertices[id2].p-p; d2 = glm::normalize(d2);
+            vec3f d1 = ctx.vertices[id1].p-p; d1 = glm::normalize(d1);
+            vec3f d2 = ctx.vertices[id2].p-p; d2 = glm::normalize(d2);
 
             if(fabs(glm::dot<3, float>(d1, d2))>0.999) {
                 return true;
@@ -48,180 +45,531 @@ namespace Simplify {
         return false;
     }
 
-    // compact triangles, compute edge error and build reference list
-
-    void update_mesh(int iteration) {
-//        if(iteration > 0) {
-//            int dst = 0;
-//
-//            for (int i = 0; i < triangles.size(); i++)
-//                if(!triangles[i].deleted) {
-//                    triangles[dst++]=triangles[i];
-//                }
-//
-//            triangles.resize(dst);
-//        }
-        //
-        // Init Quadrics by Plane & Edge Errors
-        //
-        // required at the beginning ( iteration == 0 )
-        // recomputing during the simplification is not required,
-        // but mostly improves the result for closed meshes
-        //
-        if( iteration == 0 ) {
-            for (int i = 0; i < vertices.size(); i++) {
-                vertices[i].q = SymetricMatrix(0.0);
-            }
+    //
+    // Init Quadrics by Plane & Edge Errors, the corner rings and the borders
+    //
+    // required at the beginning of a run, the rings are kept up to date by the
+    // collapses and are not rebuilt afterwards
+    //
+    // The passes below are split over threads, every pass writes disjoint data.
+    // Quadrics are gathered over the rings in triangle order, so the sums are
+    // the same as when scattering the planes triangle by triangle.
+    //
+    void update_mesh(Context &ctx) {
+        {
+            Timer timer(ctx.stats.init_time);
+
+            parallel_for(ctx.workers(), 0, static_cast<int>(ctx.triangles.size()), [&ctx](unsigned int, int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    Triangle &t=ctx.triangles[i];
+                    vec3f n,p[3];
 
-            for (int i = 0; i < triangles.size(); i++) {
-                Triangle &t=triangles[i];
-                vec3f n,p[3];
+                    for (int j = 0; j < 3; j++) {
+                        p[j]=ctx.vertices[t.v[j]].p;
+                    }
 
-                for (int j = 0; j < 3; j++) {
-                    p[j]=vertices[t.v[j]].p;
+                    n = glm::cross(p[1] - p[0], p[2] - p[0]);
+                    n = glm::normalize(n);
+                    t.n = n;
                 }
+            });
+        }
 
-                n = glm::cross(p[1] - p[0], p[2] - p[0]);
-                n = glm::normalize(n);
-                t.n = n;
+        build_adjacency(ctx);
+
+        {
+            Timer timer(ctx.stats.init_time);
 
-                for (int j = 0; j < 3; j++) {
-                    vertices[t.v[j]].q = vertices[t.v[j]].q + SymetricMatrix(n.x, n.y, n.z, -glm::dot<3, float>(n, p[0]));
+            parallel_for(ctx.workers(), 0, static_cast<int>(ctx.vertices.size()), [&ctx](unsigned int, int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    Vertex &v = ctx.vertices[i];
+                    SymetricMatrix::Sum q(0.0);
+
+                    for (int c = v.corner; c >= 0; c = ctx.next_corner[c]) {
+                        Triangle &t = ctx.triangles[c / 3];
+                        vec3f const &n = t.n;
+
+                        q += SymetricMatrix::Sum(n.x, n.y, n.z, -glm::dot<3, float>(n, ctx.vertices[t.v[0]].p));
+                    }
+
+                    v.q = SymetricMatrix(q);
                 }
-            }
+            });
 
-            for (int i = 0; i < triangles.size(); i++) {
-                // Calc Edge Error
-                Triangle &t = triangles[i];
-                vec3f p;
+            build_edges(ctx);
 
-                for (int j = 0; j < 3; j++) {
-                    t.err[j] = calculate_error(t.v[j], t.v[(j + 1) % 3], p);
+            // Calc Edge Error, once per edge
+            parallel_for(ctx.workers(), 0, static_cast<int>(ctx.edges.size()), [&ctx](unsigned int, int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    Edge &e = ctx.edges[i];
+                    e.err = calculate_error(ctx, e.v0, e.v1, e.p);
                 }
+            });
 
-                t.err[3]=glm::min(t.err[0],glm::min(t.err[1],t.err[2]));
-            }
+            parallel_for(ctx.workers(), 0, static_cast<int>(ctx.triangles.size()), [&ctx](unsigned int, int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    Triangle &t = ctx.triangles[i];
+
+                    ctx.min_error[i]=glm::min(ctx.edges[t.e[0]].err,glm::min(ctx.edges[t.e[1]].err,ctx.edges[t.e[2]].err));
+                }
+            });
         }
 
-        // Init Reference ID list
-        for (int i = 0; i < vertices.size(); i++) {
-            vertices[i].tstart=0;
-            vertices[i].tcount=0;
+        // Identify boundary : vertices[].border=0,1
+        {
+            update_border(ctx);
+
+            // the first errors are taken without borders, the positions along them are not
+            Timer timer(ctx.stats.init_time);
+
+            parallel_for(ctx.workers(), 0, static_cast<int>(ctx.edges.size()), [&ctx](unsigned int, int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    Edge &e = ctx.edges[i];
+
+                    if (ctx.vertices[e.v0].border && ctx.vertices[e.v1].border) {
+                        calculate_error(ctx, e.v0, e.v1, e.p);
+                    }
+                }
+            });
         }
-        for (int i = 0; i < triangles.size(); i++) {
-            Triangle &t = triangles[i];
+    }
+
+    // Build the corner rings of the live triangles, every ring in triangle order
+
+    void build_adjacency(Context &ctx) {
+        Timer timer(ctx.stats.adjacency_time);
+
+        for (int i = 0; i < ctx.vertices.size(); i++) {
+            ctx.vertices[i].corner=-1;
+            ctx.vertices[i].tcount=0;
+        }
+
+        ctx.next_corner.assign(ctx.triangles.size() * 3, -1);
+
+        // corners go to the front of their ring, last triangle first
+        for (int i = static_cast<int>(ctx.triangles.size()) - 1; i >= 0; i--) {
+            if (ctx.is_deleted(i)) continue;
+
+            Triangle &t=ctx.triangles[i];
 
             for (int j = 0; j < 3; j++) {
-                vertices[t.v[j]].tcount++;
+                Vertex &v = ctx.vertices[t.v[j]];
+                ctx.next_corner[i * 3 + j] = v.corner;
+                v.corner = i * 3 + j;
+                v.tcount++;
             }
         }
+    }
+
+    // Take corner c out of the ring of vertex i
 
-        int tstart = 0;
+    void unlink_corner(Context &ctx, int i, int c) {
+        Vertex &v = ctx.vertices[i];
+        int *link = &v.corner;
 
-        for (int i = 0; i < vertices.size(); i++) {
-            Vertex &v = vertices[i];
-            v.tstart = tstart;
-            tstart += v.tcount;
-            v.tcount = 0;
+        while (*link != c) {
+            link = &ctx.next_corner[*link];
         }
 
-        // Write References
-        refs.resize(triangles.size() * 3);
+        *link = ctx.next_corner[c];
+        v.tcount--;
+    }
 
-        for (int i = 0; i < triangles.size(); i++) {
-            Triangle &t=triangles[i];
+    //
+    // Unique edges of the live triangles, the rings have to be up to date. An edge gets its id
+    // at its lower vertex, all triangles with the edge share that vertex.
+    //
+    void build_edges(Context &ctx) {
+        ctx.edges.clear();
+
+        for (int i = 0; i < ctx.vertices.size(); i++) {
+            Vertex &v = ctx.vertices[i];
+            ctx.scratch.around.clear();
+
+            for (int c = v.corner; c >= 0; c = ctx.next_corner[c]) {
+                int s = c % 3;
+                Triangle &t = ctx.triangles[c / 3];
+
+                // the edges from and to the corner
+                for (int j : {s, (s + 2) % 3}) {
+                    int other = t.v[j == s ? (j + 1) % 3 : j];
+                    if (other < i) continue;
+
+                    auto it = std::find_if(ctx.scratch.around.begin(), ctx.scratch.around.end(), [other](std::pair<int, int> const &a) {
+                        return a.first == other;
+                    });
+
+                    if (it != ctx.scratch.around.end()) {
+                        t.e[j] = it->second;
+                        continue;
+                    }
 
-            for (int j = 0; j < 3; j++) {
-                Vertex &v = vertices[t.v[j]];
-                refs[v.tstart + v.tcount].tid = i;
-                refs[v.tstart + v.tcount].tvertex = j;
-                v.tcount++;
+                    t.e[j] = static_cast<int>(ctx.edges.size());
+                    ctx.scratch.around.emplace_back(other, t.e[j]);
+                    ctx.edges.push_back(Edge{i, other, 0, vec3f(0.f)});
+                }
             }
         }
+    }
 
-        // Identify boundary : vertices[].border=0,1
-        if( iteration == 0 ) {
-            std::vector<int> vcount,vids;
+    //
+    // Edges around i0 after a collapse into it. The edges of the removed vertex are merged
+    // into those of i0 to the same vertex, the others go on with i0 as their end. Every
+    // edge at i0 gets its new cost once, the edges opposite of i0 keep theirs.
+    //
+    void update_edges(Context &ctx, int i0, Scratch &scratch) {
+        Vertex &v = ctx.vertices[i0];
+        scratch.around.clear();
+
+        for (int c = v.corner; c >= 0; c = ctx.next_corner[c]) {
+            int s = c % 3;
+            Triangle &t = ctx.triangles[c / 3];
+
+            for (int j : {s, (s + 2) % 3}) {
+                int other = t.v[j == s ? (j + 1) % 3 : j];
+
+                auto it = std::find_if(scratch.around.begin(), scratch.around.end(), [other](std::pair<int, int> const &a) {
+                    return a.first == other;
+                });
+
+                if (it != scratch.around.end()) {
+                    t.e[j] = it->second;
+                    continue;
+                }
 
-            for (int i = 0; i < vertices.size(); i++) {
-                vertices[i].border = 0;
+                scratch.around.emplace_back(other, t.e[j]);
+
+                Edge &e = ctx.edges[t.e[j]];
+                e.v0 = i0;
+                e.v1 = other;
+                e.err = calculate_error(ctx, i0, other, e.p);
             }
 
-            for (int i = 0; i < vertices.size(); i++) {
-                Vertex &v = vertices[i];
-                vcount.clear();
-                vids.clear();
-
-                for (int j = 0; j < v.tcount; j++) {
-                    int k = refs[v.tstart+j].tid;
-                    Triangle &t=triangles[k];
-
-                    for (int k = 0; k < 3; k++) {
-                        int ofs=0,id=t.v[k];
-
-                        while(ofs < vcount.size()) {
-                            if(vids[ofs] == id) break;
-                            ofs++;
-                        }
-
-                        if(ofs==vcount.size()) {
-                            vcount.push_back(1);
-                            vids.push_back(id);
-                        }
-                        else {
-                            vcount[ofs]++;
-                        }
-                    }
+            ctx.min_error[c / 3] = glm::min(ctx.edges[t.e[0]].err, glm::min(ctx.edges[t.e[1]].err, ctx.edges[t.e[2]].err));
+        }
+    }
+
+    //
+    // A vertex id seen only once among the corners of the triangles around a vertex
+    // is the other end of a border edge. Corners are sorted to count them, every
+    // thread collects the border vertices of its range, flags are written at the end.
+    //
+    void update_border(Context &ctx) {
+        Timer timer(ctx.stats.border_time);
+        std::vector<std::vector<int>> border_ids(thread_count(ctx.threads));
+
+        parallel_for(ctx.workers(), 0, static_cast<int>(ctx.vertices.size()), [&ctx, &border_ids](unsigned int thread, int begin, int end) {
+            std::vector<int> ids;
+            std::vector<int> &border = border_ids[thread];
+
+            for (int i = begin; i < end; i++) {
+                Vertex &v = ctx.vertices[i];
+                ids.clear();
+
+                for (int c = v.corner; c >= 0; c = ctx.next_corner[c]) {
+                    Triangle &t = ctx.triangles[c / 3];
+
+                    ids.push_back(t.v[0]);
+                    ids.push_back(t.v[1]);
+                    ids.push_back(t.v[2]);
                 }
 
-                for (int j = 0; j < vcount.size(); j++) {
-                    if (vcount[j] == 1) {
-                        vertices[vids[j]].border = 1;
+                std::sort(ids.begin(), ids.end());
+
+                for (int j = 0; j < ids.size(); j++) {
+                    bool single = (j == 0 || ids[j - 1] != ids[j]) && (j + 1 == ids.size() || ids[j + 1] != ids[j]);
+
+                    if (single) {
+                        border.push_back(ids[j]);
                     }
                 }
             }
+        });
+
+        for (int i = 0; i < ctx.vertices.size(); i++) {
+            ctx.vertices[i].border = 0;
+        }
+
+        for (auto const &border : border_ids) {
+            for (int id : border) {
+                ctx.vertices[id].border = 1;
+            }
+        }
+    }
+
+    //
+    // Smallest threshold with the cheapest edge of at least count live triangles below it,
+    // from a histogram with steps bins per octave of the errors up to max_error. Errors
+    // below 2^low share the first bin, the last one is open so count can always be met.
+    //
+    double error_below(Context &ctx, size_t count) {
+        const int steps = 4, low = -96, high = 96;
+        const int size = (high - low) * steps;
+
+        std::vector<std::vector<size_t>> histograms(thread_count(ctx.threads), std::vector<size_t>(size));
+
+        parallel_for(ctx.workers(), 0, static_cast<int>(ctx.triangles.size()), [&](unsigned int thread, int begin, int end) {
+            std::vector<size_t> &histogram = histograms[thread];
+
+            for (int i = begin; i < end; i++) {
+                double err = ctx.min_error[i];
+
+                // NaN errors are never collapsed
+                if (ctx.is_deleted(i) || !(err <= ctx.max_error)) continue;
+
+                int bin = 0;
+
+                if (err > 0) {
+                    int e;
+                    double m = std::frexp(err, &e);  // err = m * 2^e, m in [0.5, 1)
+                    bin = glm::clamp((e - 1 - low) * steps + static_cast<int>((2 * m - 1) * steps), 0, size - 1);
+                }
+
+                histogram[bin]++;
+            }
+        });
+
+        size_t below = 0;
+
+        for (int bin = 0; bin < size - 1; bin++) {
+            for (auto const &histogram : histograms) {
+                below += histogram[bin];
+            }
+
+            // upper end of the bin, the edges are collapsed when strictly below the threshold
+            if (below >= count) return std::ldexp(1.0 + double(bin % steps + 1) / steps, bin / steps + low);
+        }
+
+        return std::numeric_limits<double>::infinity();
+    }
+
+    namespace {
+
+        // Error between vertex and Quadric in the compute precision of the quadric
+
+        template <typename T>
+        T quadric_error(SymetricMatrix::Sum const &q, T x, T y, T z) {
+            return   q[0]*x*x + 2*q[1]*x*y + 2*q[2]*x*z + 2*q[3]*x + q[4]*y*y
+                     + 2*q[5]*y*z + 2*q[6]*y + q[7]*z*z + 2*q[8]*z + q[9];
+        }
+
+        // Vector registers of the batched kernel, twice the lanes for float quadrics
+
+        template <typename T>
+        struct Lanes;
+
+#if defined(SYMETRIC_MATRIX_AVX)
+        template <>
+        struct Lanes<double> {
+            static const int width = 4;
+            using vec = __m256d;
+            static vec set1(double a) { return _mm256_set1_pd(a); }
+            static vec load(double const *a) { return _mm256_load_pd(a); }
+            static void store(double *a, vec b) { _mm256_store_pd(a, b); }
+            static vec add(vec a, vec b) { return _mm256_add_pd(a, b); }
+            static vec mul(vec a, vec b) { return _mm256_mul_pd(a, b); }
+        };
+
+        template <>
+        struct Lanes<float> {
+            static const int width = 8;
+            using vec = __m256;
+            static vec set1(float a) { return _mm256_set1_ps(a); }
+            static vec load(float const *a) { return _mm256_load_ps(a); }
+            static void store(float *a, vec b) { _mm256_store_ps(a, b); }
+            static vec add(vec a, vec b) { return _mm256_add_ps(a, b); }
+            static vec mul(vec a, vec b) { return _mm256_mul_ps(a, b); }
+        };
+#elif defined(SYMETRIC_MATRIX_SSE2)
+        template <>
+        struct Lanes<double> {
+            static const int width = 2;
+            using vec = __m128d;
+            static vec set1(double a) { return _mm_set1_pd(a); }
+            static vec load(double const *a) { return _mm_load_pd(a); }
+            static void store(double *a, vec b) { _mm_store_pd(a, b); }
+            static vec add(vec a, vec b) { return _mm_add_pd(a, b); }
+            static vec mul(vec a, vec b) { return _mm_mul_pd(a, b); }
+        };
+
+        template <>
+        struct Lanes<float> {
+            static const int width = 4;
+            using vec = __m128;
+            static vec set1(float a) { return _mm_set1_ps(a); }
+            static vec load(float const *a) { return _mm_load_ps(a); }
+            static void store(float *a, vec b) { _mm_store_ps(a, b); }
+            static vec add(vec a, vec b) { return _mm_add_ps(a, b); }
+            static vec mul(vec a, vec b) { return _mm_mul_ps(a, b); }
+        };
+#endif
+
+        template <typename T>
+        void quadric_errors(SymetricMatrix::Sum const &q, vec3f const *p, int count, double *error) {
+#if defined(SYMETRIC_MATRIX_AVX) || defined(SYMETRIC_MATRIX_SSE2)
+            using L = Lanes<T>;
+            using vec = typename L::vec;
+            const int width = L::width;
+
+            vec q0 = L::set1(q[0]), q1 = L::set1(2*q[1]), q2 = L::set1(2*q[2]), q3 = L::set1(2*q[3]), q4 = L::set1(q[4]);
+            vec q5 = L::set1(2*q[5]), q6 = L::set1(2*q[6]), q7 = L::set1(q[7]), q8 = L::set1(2*q[8]), q9 = L::set1(q[9]);
+
+            alignas(32) T xs[width], ys[width], zs[width], es[width];
+
+            for (int i = 0; i < count; i += width) {
+                int n = glm::min(width, count - i);
+
+                for (int k = 0; k < width; k++) {
+                    vec3f const &v = p[i + glm::min(k, n - 1)];
+                    xs[k] = v.x; ys[k] = v.y; zs[k] = v.z;
+                }
+
+                vec x = L::load(xs), y = L::load(ys), z = L::load(zs);
+
+                vec e = L::mul(L::mul(q0, x), x);
+                e = L::add(e, L::mul(L::mul(q1, x), y));
+                e = L::add(e, L::mul(L::mul(q2, x), z));
+                e = L::add(e, L::mul(q3, x));
+                e = L::add(e, L::mul(L::mul(q4, y), y));
+                e = L::add(e, L::mul(L::mul(q5, y), z));
+                e = L::add(e, L::mul(q6, y));
+                e = L::add(e, L::mul(L::mul(q7, z), z));
+                e = L::add(e, L::mul(q8, z));
+                e = L::add(e, q9);
+
+                L::store(es, e);
+
+                for (int k = 0; k < n; k++) {
+                    error[i + k] = es[k];
+                }
+            }
+#else
+            for (int i = 0; i < count; i++) {
+                error[i] = quadric_error<T>(q, p[i].x, p[i].y, p[i].z);
+            }
+#endif
         }
+
     }
 
     // Error between vertex and Quadric
 
-    double vertex_error(SymetricMatrix q, double x, double y, double z) {
-        return   q[0]*x*x + 2*q[1]*x*y + 2*q[2]*x*z + 2*q[3]*x + q[4]*y*y
-                 + 2*q[5]*y*z + 2*q[6]*y + q[7]*z*z + 2*q[8]*z + q[9];
+    double vertex_error(SymetricMatrix::Sum const &q, double x, double y, double z) {
+        using T = SymetricMatrix::compute;
+
+        return quadric_error<T>(q, static_cast<T>(x), static_cast<T>(y), static_cast<T>(z));
+    }
+
+    //
+    // Error between a batch of vertices and one Quadric. Lanes evaluate the same
+    // expression as the scalar version term by term, so both give equal results.
+    //
+    void vertex_error(SymetricMatrix::Sum const &q, vec3f const *p, int count, double *error) {
+        quadric_errors<SymetricMatrix::compute>(q, p, count, error);
     }
 
     // Error for one edge
 
-    double calculate_error(int id_v1, int id_v2, vec3f &p_result)
+    double calculate_error(Context &ctx, int id_v1, int id_v2, vec3f &p_result)
     {
+        if (ctx.has_attributes()) {
+            return calculate_attribute_error(ctx, id_v1, id_v2, p_result, nullptr);
+        }
+
         // compute interpolated vertex
 
-        SymetricMatrix q = vertices[id_v1].q + vertices[id_v2].q;
+        SymetricMatrix::Sum q = ctx.vertices[id_v1].q + ctx.vertices[id_v2].q;
 
-        bool   border = vertices[id_v1].border & vertices[id_v2].border;
+        bool   border = ctx.vertices[id_v1].border & ctx.vertices[id_v2].border;
         double error=0;
-        double det = q.det(0, 1, 2, 1, 4, 5, 2, 5, 7);
+        double x, y, z;
+        double det = q.solve(x, y, z);
 
         if ( det != 0 && !border ) {
             // q_delta is invertible
-            p_result.x = -1 / det * (q.det(1, 2, 3, 4, 5, 6, 5, 7 , 8));	// vx = A41/det(q_delta)
-            p_result.y =  1 / det * (q.det(0, 2, 3, 1, 5, 6, 2, 7 , 8));	// vy = A42/det(q_delta)
-            p_result.z = -1 / det * (q.det(0, 1, 3, 1, 4, 6, 2, 5,  8));	// vz = A43/det(q_delta)
+            p_result.x = x;
+            p_result.y = y;
+            p_result.z = z;
             error = vertex_error(q, p_result.x, p_result.y, p_result.z);
         }
         else {
             // det = 0 -> try to find best result
-            vec3f p1 = vertices[id_v1].p;
-            vec3f p2 = vertices[id_v2].p;
-            vec3f p3 = (p1 + p2) / 2.0f;
-
-            double error1 = vertex_error(q, p1.x,p1.y,p1.z);
-            double error2 = vertex_error(q, p2.x,p2.y,p2.z);
-            double error3 = vertex_error(q, p3.x,p3.y,p3.z);
-            error = glm::min(error1, glm::min(error2, error3));
-            if (error1 == error) p_result=p1;
-            if (error2 == error) p_result=p2;
-            if (error3 == error) p_result=p3;
+            vec3f p[3];
+            p[0] = ctx.vertices[id_v1].p;
+            p[1] = ctx.vertices[id_v2].p;
+            p[2] = (p[0] + p[1]) / 2.0f;
+
+            double errors[3];
+            vertex_error(q, p, 3, errors);
+
+            error = glm::min(errors[0], glm::min(errors[1], errors[2]));
+            p_result=p[2]; // error is NaN for degenerate quadrics
+            if (errors[0] == error) p_result=p[0];
+            if (errors[1] == error) p_result=p[1];
+            if (errors[2] == error) p_result=p[2];
+        }
+
+        return error;
+    }
+
+    //
+    // Error for one edge over position and attributes, the same choices as
+    // calculate_error in the higher dimension. The scaled attributes of the
+    // result are written to attributes when it is set.
+    //
+    double calculate_attribute_error(Context &ctx, int id_v1, int id_v2, vec3f &p_result, double *attributes)
+    {
+        const int size = AttributeQuadric::size;
+        const int channels = Context::attribute_channels;
+
+        AttributeQuadric q = ctx.attribute_quadrics[id_v1] + ctx.attribute_quadrics[id_v2];
+
+        bool   border = ctx.vertices[id_v1].border & ctx.vertices[id_v2].border;
+        double error=0;
+        double v[size];
+
+        if ( border || !q.solve(v) ) {
+            // try to find best result among the ends and the midpoint
+            double p[3][size];
+
+            for (int k = 0; k < 2; k++) {
+                int id = k == 0 ? id_v1 : id_v2;
+                vec3f const &position = ctx.vertices[id].p;
+
+                p[k][0] = position.x;
+                p[k][1] = position.y;
+                p[k][2] = position.z;
+
+                std::copy(ctx.attributes.begin() + id * channels, ctx.attributes.begin() + (id + 1) * channels, p[k] + 3);
+            }
+
+            for (int i = 0; i < size; i++) {
+                p[2][i] = (p[0][i] + p[1][i]) / 2;
+            }
+
+            double errors[3];
+
+            for (int k = 0; k < 3; k++) {
+                errors[k] = q.error(p[k]);
+            }
+
+            error = glm::min(errors[0], glm::min(errors[1], errors[2]));
+
+            int best = 2; // error is NaN for degenerate quadrics
+            if (errors[0] == error) best = 0;
+            if (errors[1] == error) best = 1;
+            if (errors[2] == error) best = 2;
+
+            std::copy(p[best], p[best] + size, v);
+        }
+        else {
+            error = q.error(v);
+        }
+
+        p_result = vec3f(v[0], v[1], v[2]);
+
+        if (attributes) {
+            std::copy(v + 3, v + size, attributes);
         }
 
         return error;
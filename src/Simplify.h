@@ -2,329 +2,1768 @@
 
 #include <glm/glm.hpp>
 #include <vector>
+#include <queue>
+#include <functional>
 #include <cmath>
 #include <iostream>
 #include <memory.h>
-#include "Mesh.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+#include "SymetricMatrix.h"
+#include "AttributeQuadric.h"
+#include "../common/parallel.h"
 
 #define loop(var_l,start_l,end_l) for ( int var_l=start_l;var_l<end_l;++var_l )
 
 
-template <typename T>
+using uint = unsigned int;
+
+
+template <typename T, typename S>
 class Mesh;
 
 
-class SymetricMatrix {
+///////////////////////////////////////////
+
+namespace Simplify
+{
+    // Structures
+
+    using vec3f = glm::vec3;
+
+    enum class Method {
+        Threshold,  // sweep all triangles against a growing error threshold
+        Heap,       // always collapse the cheapest valid edge first
+        Partitioned,// threshold sweep on spatial cells in parallel, then over the seams
+        Clustering, // snap vertices to a grid, linear time preview quality
+        Parallel    // collapse independent sets of edges on all threads, the same result for any thread count
+    };
+
+    enum class ErrorBound {
+        Quadric,    // edge error as computed by calculate_error
+        Distance    // distance in model units, the quadric error is bounded by its square
+    };
+
+    enum class Schedule {
+        Fixed,      // 1e-9 * (iteration + 3)^agressiveness
+        Adaptive    // from the current edge errors, every pass aims at a share of the triangles left to remove
+    };
+
+    struct Triangle { int v[3];int e[3]; vec3f n; };   // e[j] is the edge v[j] - v[j+1]
 
-public:
+    // Edge shared by the triangles around it, with the cost and position of its collapse
 
-    // Constructor
+    struct Edge { int v0,v1;double err; vec3f p; };
 
-    SymetricMatrix(double c=0) {
-        for (int i = 0; i < 10; i++) {
-            m[i] = c;
+    enum TriangleFlags : unsigned char {
+        TriangleDeleted = 1,
+        TriangleDirty = 2     // edge errors changed since the heap entry or the start of the pass
+    };
+    struct Vertex { vec3f p;int corner,tcount;SymetricMatrix q;int border;};   // corner starts the ring, -1 when empty
+
+    // Collapse candidate, only the latest entry pushed for a triangle is valid
+
+    struct HeapEntry {
+        double err;
+        int tid;
+
+        bool operator>(HeapEntry const &e) const {
+            if (err != e.err) return err > e.err;
+            return tid > e.tid;
         }
-    }
+    };
 
-    SymetricMatrix(	double m11, double m12, double m13, double m14,
-                       double m22, double m23, double m24,
-                       double m33, double m34,
-                       double m44) {
-        m[0] = m11;  m[1] = m12;  m[2] = m13;  m[3] = m14;
-        m[4] = m22;  m[5] = m23;  m[6] = m24;
-        m[7] = m33;  m[8] = m34;
-        m[9] = m44;
-    }
+    using Heap = std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>>;
 
-    // Make plane
+    // Edge below the threshold of a parallel round, ordered by error and then by id
 
-    SymetricMatrix(double a,double b,double c,double d)
-    {
-        m[0] = a*a;  m[1] = a*b;  m[2] = a*c;  m[3] = a*d;
-        m[4] = b*b;  m[5] = b*c;  m[6] = b*d;
-        m[7 ] =c*c;  m[8 ] = c*d;
-        m[9 ] = d*d;
-    }
+    struct Candidate {
+        double err;
+        int edge;
 
-    double operator[](int c) const { return m[c]; }
+        bool operator<(Candidate const &c) const {
+            if (err != c.err) return err < c.err;
+            return edge < c.edge;
+        }
+    };
+
+    // Edge collapse v1 -> v0, the changed corners and removed triangles are ranges of Record
+
+    struct Collapse {
+        int v0, v1;
+        float t;            // interpolation parameter of the new v0 between v0 and v1
+        int corners_end;    // end of the corners moved from v1 to v0 in Record::corners
+        int faces_end;      // end of the triangles removed in Record::faces
+    };
+
+    //
+    // Collapse sequence of one run, in order. Corners are stored as triangle * 3 + corner,
+    // triangle ids stay the same until compact_mesh.
+    //
+    struct Record {
+        std::vector<Collapse> collapses;
+        std::vector<int> corners;
+        std::vector<int> faces;
+
+        void clear() {
+            collapses.clear();
+            corners.clear();
+            faces.clear();
+        }
+    };
+
+    //
+    // State of a run for other threads, e.g. a progress bar. The heap counts popped entries
+    // as iterations. A run stops early when cancel is set, the mesh is left as far as it got.
+    // The cells of a partitioned run have their own progress, they add their changes to the
+    // counts of the parent and stop when it is cancelled.
+    //
+    struct Progress {
+        std::atomic<int> iteration{0};
+        std::atomic<int> triangles{0};
+        std::atomic<bool> cancel{false};
+
+        Progress *parent = nullptr;
+
+        void publish(int iteration_count, int triangle_count) {
+            int last_iteration = iteration.exchange(iteration_count, std::memory_order_relaxed);
+            int last_triangles = triangles.exchange(triangle_count, std::memory_order_relaxed);
+
+            if (parent) parent->add(iteration_count - last_iteration, triangle_count - last_triangles);
+        }
 
-    // Determinant
+        void add(int iterations, int triangle_count) {
+            iteration.fetch_add(iterations, std::memory_order_relaxed);
+            triangles.fetch_add(triangle_count, std::memory_order_relaxed);
 
-    double det(	int a11, int a12, int a13,
-                   int a21, int a22, int a23,
-                   int a31, int a32, int a33)
-    {
-        double det =  m[a11]*m[a22]*m[a33] + m[a13]*m[a21]*m[a32] + m[a12]*m[a23]*m[a31]
-                      - m[a13]*m[a22]*m[a31] - m[a11]*m[a23]*m[a32]- m[a12]*m[a21]*m[a33];
-        return det;
-    }
+            if (parent) parent->add(iterations, triangle_count);
+        }
 
-    const SymetricMatrix operator+(const SymetricMatrix& n) const
-    {
-        return SymetricMatrix( m[0]+n[0],   m[1]+n[1],   m[2]+n[2],   m[3]+n[3],
-                               m[4]+n[4],   m[5]+n[5],   m[6]+n[6],
-                               m[ 7]+n[ 7], m[ 8]+n[8 ],
-                               m[ 9]+n[9 ]);
-    }
+        bool cancelled() const {
+            return cancel.load(std::memory_order_relaxed) || (parent && parent->cancelled());
+        }
+    };
+
+    //
+    // Where a run spends its time and why edges are not collapsed. Times are in seconds,
+    // the phases don't overlap. Counters and times add up over the runs with a context,
+    // the cells of a partitioned run are summed (their time over all threads), the largest
+    // error is the maximum of them.
+    //
+    struct Stats {
+        double init_time = 0;       // import, plane quadrics, edge errors and heap builds
+        double border_time = 0;     // border detection
+        double adjacency_time = 0;  // building the corner rings
+        double collapse_time = 0;   // collapse passes, the heap loop or the clustering probes
+        double compact_time = 0;    // dropping deleted triangles and unused vertices
+
+        size_t iterations = 0;      // threshold passes, popped heap entries, parallel rounds or clustering probes
+        size_t attempted = 0;       // edges below the threshold that were checked
+        size_t collapses = 0;
+        size_t rejected_border = 0; // one end on the border, the other not
+        size_t rejected_locked = 0;
+        size_t rejected_flip = 0;   // a triangle around it would flip or degenerate
+        size_t rejected_target = 0; // would remove more triangles than the target leaves
+        size_t rejected_dirty = 0;  // triangles skipped since their errors are out of date
+        size_t rejected_overlap = 0;// one-ring taken by a cheaper collapse of the same parallel round
+
+        double max_collapse_error = 0;  // largest edge error collapsed, clustering collapses no edges
+
+        double total_time() const {
+            return init_time + border_time + adjacency_time + collapse_time + compact_time;
+        }
 
-    SymetricMatrix& operator+=(const SymetricMatrix& n)
-    {
-        m[0]+=n[0];   m[1]+=n[1];   m[2]+=n[2];   m[3]+=n[3];
-        m[4]+=n[4];   m[5]+=n[5];   m[6]+=n[6];   m[7]+=n[7];
-        m[8]+=n[8];   m[9]+=n[9];
-        return *this;
-    }
+        Stats &operator+=(Stats const &s) {
+            init_time += s.init_time;
+            border_time += s.border_time;
+            adjacency_time += s.adjacency_time;
+            collapse_time += s.collapse_time;
+            compact_time += s.compact_time;
+            iterations += s.iterations;
+            attempted += s.attempted;
+            collapses += s.collapses;
+            rejected_border += s.rejected_border;
+            rejected_locked += s.rejected_locked;
+            rejected_flip += s.rejected_flip;
+            rejected_target += s.rejected_target;
+            rejected_dirty += s.rejected_dirty;
+            rejected_overlap += s.rejected_overlap;
+            max_collapse_error = std::max(max_collapse_error, s.max_collapse_error);
+            return *this;
+        }
+    };
 
-    double m[10];
-};
-///////////////////////////////////////////
+    // Adds the seconds from its construction to its destruction to total
 
-namespace Simplify
-{
-    // Global Variables & Strctures
+    struct Timer {
+        double *total;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-    using vec3f = glm::vec3;
+        explicit Timer(double &total) : total(&total) {}
+
+        ~Timer() {
+            stop();
+        }
+
+        // add the time so far and go on timing next
+        void restart(double &next) {
+            stop();
+            total = &next;
+        }
+
+        void stop() {
+            auto now = std::chrono::steady_clock::now();
+
+            if (total) *total += std::chrono::duration<double>(now - start).count();
+
+            total = nullptr;
+            start = now;
+        }
+    };
+
+    // Buffers of one collapse, every thread collapsing edges needs its own
+
+    struct Scratch {
+        std::vector<int> deleted0;
+        std::vector<int> deleted1;
+        std::vector<std::pair<int, int>> around;   // other end and id of the edges at a vertex
+
+        void clear() {
+            deleted0.clear();
+            deleted1.clear();
+            around.clear();
+        }
+    };
+
+    //
+    // Simplification state, owned by the caller. Every thread has to use its own
+    // context, buffers keep their capacity so a context can be reused between runs.
+    //
+    struct Context {
+        // attributes a vertex can have next to its position
+        static const int attribute_channels = AttributeQuadric::size - 3;
+
+        // worker threads for the parallel passes, 0 means one per hardware thread
+        unsigned int threads = 0;
 
-    struct Triangle { int v[3];double err[4];int deleted,dirty; vec3f n; };
-    struct Vertex { vec3f p;int tstart,tcount;SymetricMatrix q;int border;};
-    struct Ref { int tid,tvertex; };
+        // weight of the vertex attributes (colour, uv) in the edge error, 0 uses positions only
+        double attribute_weight = 0;
 
-    extern std::vector<Triangle> triangles;
-    extern std::vector<Vertex> vertices;
-    extern std::vector<Ref> refs;
+        // edges with a larger error are not collapsed, the target count may not be reached then
+        double max_error = std::numeric_limits<double>::infinity();
+
+        // threshold growth of the sweeps and parallel rounds, see ThresholdSchedule
+        Schedule schedule = Schedule::Fixed;
+        double schedule_share = 0.5;    // of the triangles above the target, removed per adaptive pass
+
+        // collapses are appended here when set
+        Record *record = nullptr;
+
+        // updated while running when set
+        Progress *progress = nullptr;
+
+        // no start and summary lines, for runs inside another method
+        bool quiet = false;
+
+        // filled while running, not reset by clear()
+        Stats stats;
+
+        // vertices that must not move, indexed like the mesh vertices, empty locks nothing
+        std::vector<char> locked;
+
+        // new index of every imported vertex after compact_mesh, -1 when it was removed
+        std::vector<int> remap;
+
+        //
+        // Triangle state split by access: the sweeps stream min_error and flags, the
+        // indices, edge errors and normals in triangles are only read for candidates.
+        // The three arrays are indexed alike, see move_triangle and resize_triangles.
+        //
+        std::vector<Triangle> triangles;
+        std::vector<double> min_error;
+        std::vector<unsigned char> flags;
+
+        std::vector<Edge> edges;
+        std::vector<Vertex> vertices;
+
+        //
+        // Triangles around a vertex: its ring starts at Vertex::corner and goes on through
+        // next_corner, indexed by corner (triangle * 3 + corner) and -1 at the end. Rings
+        // only hold live triangles, collapses relink them in place.
+        //
+        std::vector<int> next_corner;
+
+        // per vertex when attribute_weight is set, attributes hold attribute_channels scaled values each
+        std::vector<AttributeQuadric> attribute_quadrics;
+        std::vector<double> attributes;
+        double attribute_scale = 1;
+
+        // scratch buffers
+        Scratch scratch;
+        std::vector<double> keys;
+
+        // workers of the parallel passes, kept while the context lives
+        LazyThreadPool pool;
+
+        ThreadPool &workers() {
+            return pool.get(threads);
+        }
+
+        void clear() {
+            triangles.clear();
+            min_error.clear();
+            flags.clear();
+            edges.clear();
+            vertices.clear();
+            next_corner.clear();
+            attribute_quadrics.clear();
+            attributes.clear();
+            scratch.clear();
+            keys.clear();
+            remap.clear();
+        }
+
+        bool is_locked(int v) const {
+            return !locked.empty() && locked[v];
+        }
+
+        bool has_attributes() const {
+            return !attribute_quadrics.empty();
+        }
+
+        bool is_deleted(int t) const {
+            return (flags[t] & TriangleDeleted) != 0;
+        }
+
+        bool is_dirty(int t) const {
+            return (flags[t] & TriangleDirty) != 0;
+        }
+
+        void set_deleted(int t) {
+            flags[t] |= TriangleDeleted;
+        }
+
+        void set_dirty(int t) {
+            flags[t] |= TriangleDirty;
+        }
+
+        void clear_dirty(int t) {
+            flags[t] &= ~TriangleDirty;
+        }
+
+        // copy triangle src to dst when compacting, dst <= src
+
+        void move_triangle(int dst, int src) {
+            triangles[dst] = triangles[src];
+            min_error[dst] = min_error[src];
+            flags[dst] = flags[src];
+        }
+
+        void resize_triangles(size_t size) {
+            triangles.resize(size);
+            min_error.resize(size);
+            flags.resize(size);
+        }
+
+        // publish the state of a run, false when it has to stop
+
+        bool report(int iteration, int triangle_count) {
+            if (!progress) return true;
+
+            progress->publish(iteration, triangle_count);
+
+            return !progress->cancelled();
+        }
+    };
 
     // Helper functions
 
-    double vertex_error(SymetricMatrix q, double x, double y, double z);
-    double calculate_error(int id_v1, int id_v2, vec3f &p_result);
-    bool flipped(vec3f p,int i0,int i1,Vertex &v0,Vertex &v1,std::vector<int> &deleted);
-    void update_mesh(int iteration);
+    double vertex_error(SymetricMatrix::Sum const &q, double x, double y, double z);
+    void vertex_error(SymetricMatrix::Sum const &q, vec3f const *p, int count, double *error);
+    double calculate_error(Context &ctx, int id_v1, int id_v2, vec3f &p_result);
+    double calculate_attribute_error(Context &ctx, int id_v1, int id_v2, vec3f &p_result, double *attributes);
+    bool flipped(Context &ctx, vec3f p,int i0,int i1,Vertex &v0,Vertex &v1,std::vector<int> &deleted);
+    void update_mesh(Context &ctx);
+    void build_adjacency(Context &ctx);
+    void unlink_corner(Context &ctx, int i, int c);
+    void update_border(Context &ctx);
+    void build_edges(Context &ctx);
+    void update_edges(Context &ctx, int i0, Scratch &scratch);
+    double error_below(Context &ctx, size_t count);
+
+    //
+    // Threshold of every pass. The adaptive one is the error below which the cheapest
+    // edges of the share of the live triangles still to remove lie, a collapse takes two
+    // triangles and its edge is the cheapest of about two. Passes remove fewer than that
+    // (dirty neighbours, flips), so the share is scaled by how far the last one fell short.
+    // The threshold never goes down.
+    //
+    struct ThresholdSchedule {
+        double threshold = 0;
+        double gain = 1;
+        int aimed = 0;      // triangles the last pass was to remove, from last_count
+        int last_count = 0;
+
+        double next(Context &ctx, int iteration, int triangle_count, int target, double agressiveness) {
+            if (ctx.schedule == Schedule::Fixed) {
+                return threshold = 0.000000001*pow(double(iteration+3),agressiveness);
+            }
 
+            if (aimed > 0) {
+                int removed = last_count - triangle_count;
+                gain = glm::clamp(gain * (removed > 0 ? glm::min(double(aimed) / removed, 4.0) : 4.0), 0.25, 1e6);
+            }
 
-    // Update triangle connections and edge error after a edge is collapsed
+            double share = glm::clamp(ctx.schedule_share, 0.0, 1.0);
+            aimed = glm::max(1, static_cast<int>(share * (triangle_count - target)));
+            last_count = triangle_count;
+
+            double count = glm::min(gain * aimed, double(triangle_count));
+            return threshold = glm::max(threshold, error_below(ctx, static_cast<size_t>(count)));
+        }
+    };
 
-    template <typename T>
-    void update_triangles(Mesh<T> *mesh, int i0,Vertex &v,std::vector<int> &deleted,int &deleted_triangles) {
-        vec3f p;
 
-        for (int k = 0; k < v.tcount; k++) {
-            Ref &r = refs[v.tstart + k];
-            Triangle &t = triangles[r.tid];
+    //
+    // Update triangle connections after a edge i0-i1 is collapsed, the edges follow in
+    // update_edges. The live corners of v are linked to the ring of i0 after last, the
+    // corners of removed triangles leave the ring of their third vertex.
+    //
+    template <typename T, typename S>
+    void update_triangles(Context &ctx, Mesh<T, S> *mesh, int i0,int i1,Vertex &v,std::vector<int> &deleted,int &deleted_triangles,int &last) {
+        Vertex &v0 = ctx.vertices[i0];
+        int k = 0;
 
-            if(t.deleted) continue;
+        for (int c = v.corner, next; c >= 0; c = next, k++) {
+            next = ctx.next_corner[c];
+
+            int tid = c / 3, s = c % 3;
+            Triangle &t = ctx.triangles[tid];
+
+            if(ctx.is_deleted(tid)) continue;
 
             if(deleted[k]) {
-                t.deleted = 1;
+                ctx.set_deleted(tid);
                 deleted_triangles++;
+                if (ctx.record) ctx.record->faces.push_back(tid);
+
+                for (int j = 0; j < 3; j++) {
+                    if (t.v[j] != i0 && t.v[j] != i1) unlink_corner(ctx, t.v[j], tid * 3 + j);
+                }
                 continue;
             }
 
-            t.v[r.tvertex] = i0;
-            memcpy(reinterpret_cast<unsigned char *>(mesh->m_faces.data() + r.tid) + r.tvertex * sizeof(uint), &i0, sizeof(uint));
-            t.dirty = 1;
-            t.err[0] = calculate_error(t.v[0], t.v[1], p);
-            t.err[1] = calculate_error(t.v[1], t.v[2], p);
-            t.err[2] = calculate_error(t.v[2], t.v[0], p);
-            t.err[3] = glm::min(t.err[0], glm::min(t.err[1], t.err[2]));
-            refs.push_back(r);
+            if (ctx.record && t.v[s] != i0) ctx.record->corners.push_back(c);
+
+            t.v[s] = i0;
+            memcpy(reinterpret_cast<unsigned char *>(mesh->m_faces.data() + tid) + s * sizeof(uint), &i0, sizeof(uint));
+            ctx.set_dirty(tid);
+
+            if (last < 0) v0.corner = c; else ctx.next_corner[last] = c;
+            last = c;
+            v0.tcount++;
         }
     }
 
-    template <typename T>
-    void compact_mesh(Mesh<T> *mesh) {
-        uint dst = 0;
+    //
+    // Attributes of the vertex collapsing i0-i1, the minimum of their summed attribute
+    // quadrics. The quadric of i1 is added to i0. Face corners around both vertices
+    // that have the uv of the vertex take the new one, corners on the other side of
+    // a uv seam keep theirs.
+    //
+    template <typename T, typename S>
+    void collapse_attributes(Context &ctx, Mesh<T, S> *mesh, int i0, int i1, float *attributes) {
+        const int channels = Context::attribute_channels;
+        double a[channels];
+        vec3f p;
+
+        calculate_attribute_error(ctx, i0, i1, p, a);
+
+        for (int k = 0; k < T::attribute_count; k++) {
+            attributes[k] = static_cast<float>(a[k] / ctx.attribute_scale);
+        }
+
+        ctx.attribute_quadrics[i0] += ctx.attribute_quadrics[i1];
+        std::copy(a, a + channels, ctx.attributes.begin() + i0 * channels);
+
+        if (T::uv_attribute < 0) return;
+
+        glm::vec2 uv(attributes[T::uv_attribute], attributes[T::uv_attribute + 1]);
+
+        for (int i : {i0, i1}) {
+            Vertex &v = ctx.vertices[i];
+            float old[channels];
+
+            mesh->vertex(i).components.get_attributes(old);
+            glm::vec2 old_uv(old[T::uv_attribute], old[T::uv_attribute + 1]);
+
+            for (int c = v.corner; c >= 0; c = ctx.next_corner[c]) {
+                if (ctx.is_deleted(c / 3)) continue;
+
+                glm::vec2 &corner = *(&mesh->m_faces[c / 3].uv0 + c % 3);
+                if (corner == old_uv) corner = uv;
+            }
+        }
+    }
+
+    // Collapse edge i0-i1 into i0 placed at p, deleted0/deleted1 of scratch have to be filled by flipped()
+
+    template <typename T, typename S>
+    void collapse_edge(Context &ctx, Mesh<T, S> *mesh, int i0, int i1, vec3f const &p, int &deleted_triangles, Scratch &scratch) {
+        Vertex &v0 = ctx.vertices[i0];
+        Vertex &v1 = ctx.vertices[i1];
+
+        float attributes[Context::attribute_channels];
+
+        if (ctx.has_attributes()) {
+            collapse_attributes(ctx, mesh, i0, i1, attributes);
+        }
+
+        v0.p = p;
+
+        auto vertex = mesh->vertex(i0);
+        auto const &_vp0 = mesh->position(i0);
+        auto const &_vp1 = mesh->position(i1);
+
+        float t = glm::distance(_vp0, p) / glm::distance(_vp0, _vp1);
+
+        vertex.components.interpolate(vertex.components, mesh->vertex(i1).components, t);
 
-        for (uint i = 0; i < vertices.size(); i++) {
-            vertices[i].tcount = 0;
+        if (ctx.has_attributes()) {
+            vertex.components.set_attributes(attributes);
         }
 
-        for (int i = 0; i < triangles.size(); i++) {
-            if (!triangles[i].deleted) {
-                Triangle &t = triangles[i];
-                triangles[dst++] = t;
+        //vertex.components.position = p;
+        mesh->set_vertex(i0, vertex);
+        v0.q += v1.q;
+
+        // the ring of i0 is relinked from the live corners of both
+        int last = -1;
+        v0.tcount = 0;
+
+        update_triangles(ctx, mesh, i0,i1,v0,scratch.deleted0,deleted_triangles,last);
+        update_triangles(ctx, mesh, i0,i1,v1,scratch.deleted1,deleted_triangles,last);
+
+        if (last < 0) v0.corner = -1; else ctx.next_corner[last] = -1;
+
+        v1.corner = -1;
+        v1.tcount = 0;
+
+        update_edges(ctx, i0, scratch);
+
+        if (ctx.record) {
+            ctx.record->collapses.push_back(Collapse{i0, i1, t, static_cast<int>(ctx.record->corners.size()), static_cast<int>(ctx.record->faces.size())});
+        }
+    }
+
+    // Drop deleted triangles and unused vertices, the corner rings are out of date afterwards
+
+    template <typename T, typename S>
+    void compact_mesh(Context &ctx, Mesh<T, S> *mesh) {
+        Timer timer(ctx.stats.compact_time);
+        uint dst = 0;
+
+        ctx.remap.assign(ctx.vertices.size(), -1);
+
+        for (int i = 0; i < ctx.triangles.size(); i++) {
+            if (!ctx.is_deleted(i)) {
+                ctx.move_triangle(dst++, i);
+                Triangle &t = ctx.triangles[dst - 1];
 
                 mesh->m_faces.at(dst - 1) = mesh->m_faces.at(i);
 
                 for (uint j = 0; j < 3; j++) {
-                    vertices[t.v[j]].tcount = 1;
+                    ctx.remap[t.v[j]] = 0;
                 }
             }
         }
 
-        triangles.resize(dst);
+        ctx.resize_triangles(dst);
         mesh->m_faces.resize(dst);
         dst = 0;
 
-        for (int i = 0; i < vertices.size(); i++) {
-            if (vertices[i].tcount) {
-                vertices[i].tstart = dst;
-                vertices[dst].p = vertices[i].p;
+        for (int i = 0; i < ctx.vertices.size(); i++) {
+            if (ctx.remap[i] >= 0) {
+                ctx.remap[i] = dst;
+                ctx.vertices[dst].p = ctx.vertices[i].p;
 
-                mesh->m_vertices.at(dst) = mesh->m_vertices.at(i);
+                mesh->set_vertex(dst, mesh->vertex(i));
 
                 dst++;
             }
         }
 
-        for (uint i = 0; i < triangles.size(); i++) {
-            Triangle &t = triangles[i];
+        for (uint i = 0; i < ctx.triangles.size(); i++) {
+            Triangle &t = ctx.triangles[i];
             auto &mesh_triangle = mesh->m_faces.at(i);
 
             for (int j = 0; j < 3; j++) {
-                t.v[j] = vertices[t.v[j]].tstart;
+                t.v[j] = ctx.remap[t.v[j]];
 
                 *(&mesh_triangle.v0 + j) = static_cast<uint>(t.v[j]);
             }
         }
 
-        vertices.resize(dst);
+        ctx.vertices.resize(dst);
         mesh->m_vertices.resize(dst);
     }
 
-    template <typename T>
-    void simplify_mesh(Mesh<T> *mesh, int target_count, double agressiveness=7) {
-        // init
-        printf("%s - start\n",__FUNCTION__);
-        //int timeStart=timeGetTime();
+    //
+    // Attribute quadric of every vertex, summed over its faces. Attributes are scaled by
+    // attribute_weight times the bounding box diagonal, so their full range weighs like
+    // the size of the mesh. The uvs of a face are those of its corners: a vertex on a uv
+    // seam gets the quadrics of both sides and collapses across the seam cost more.
+    //
+    template <typename T, typename S>
+    void import_attributes(Context &ctx, Mesh<T, S> *mesh) {
+        const int channels = Context::attribute_channels;
+        static_assert(T::attribute_count <= Context::attribute_channels, "too many vertex attributes");
+
+        vec3f lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+
+        for (uint i = 0; i < mesh->vertex_count(); i++) {
+            lo = glm::min(lo, mesh->position(i));
+            hi = glm::max(hi, mesh->position(i));
+        }
+
+        ctx.attribute_scale = ctx.attribute_weight * glm::max(static_cast<double>(glm::distance(lo, hi)), 1e-20);
+        ctx.attribute_quadrics.assign(mesh->m_vertices.size(), AttributeQuadric());
+        ctx.attributes.assign(mesh->m_vertices.size() * channels, 0.0);
 
-        vertices.clear();
-        triangles.clear();
+        for (int i = 0; i < mesh->m_vertices.size(); i++) {
+            float a[channels];
+            mesh->vertex(i).components.get_attributes(a);
 
-        for (auto &vertex : mesh->m_vertices) {
+            for (int k = 0; k < T::attribute_count; k++) {
+                ctx.attributes[i * channels + k] = a[k] * ctx.attribute_scale;
+            }
+        }
+
+        for (auto const &face : mesh->m_faces) {
+            double p[3][AttributeQuadric::size];
+
+            for (int j = 0; j < 3; j++) {
+                uint v = *(&face.v0 + j);
+                vec3f const &position = ctx.vertices[v].p;
+
+                p[j][0] = position.x;
+                p[j][1] = position.y;
+                p[j][2] = position.z;
+
+                std::copy(ctx.attributes.begin() + v * channels, ctx.attributes.begin() + (v + 1) * channels, p[j] + 3);
+
+                if (T::uv_attribute >= 0) {
+                    glm::vec2 const &uv = *(&face.uv0 + j);
+
+                    p[j][3 + T::uv_attribute] = uv.x * ctx.attribute_scale;
+                    p[j][4 + T::uv_attribute] = uv.y * ctx.attribute_scale;
+                }
+            }
+
+            AttributeQuadric q(p[0], p[1], p[2]);
+
+            ctx.attribute_quadrics[face.v0] += q;
+            ctx.attribute_quadrics[face.v1] += q;
+            ctx.attribute_quadrics[face.v2] += q;
+        }
+    }
+
+    template <typename T, typename S>
+    void import_mesh(Context &ctx, Mesh<T, S> *mesh) {
+        Timer timer(ctx.stats.init_time);
+
+        ctx.clear();
+
+        for (uint i = 0; i < mesh->vertex_count(); i++) {
             Vertex v;
-            v.p = vertex.components.position;
+            v.p = mesh->position(i);
+            v.border = 0; // read by the first edge errors, before borders are detected
 
-            vertices.push_back(v);
+            ctx.vertices.push_back(v);
         }
 
         for (auto &triangle : mesh->m_faces) {
             Triangle t;
             memcpy(t.v, &triangle.v0, 3 * sizeof(uint));
 
-            triangles.push_back(t);
+            ctx.triangles.push_back(t);
         }
 
-        for (int i = 0; i < triangles.size(); i++) {
-            triangles[i].deleted = 0;
+        // errors are set by update_mesh
+        ctx.min_error.assign(ctx.triangles.size(), 0);
+        ctx.flags.assign(ctx.triangles.size(), 0);
+
+        if (ctx.attribute_weight > 0 && T::attribute_count > 0) {
+            import_attributes(ctx, mesh);
         }
+    }
 
-        // main iteration loop
+    // Copy of the live triangles of a run and the vertices they use, ctx.triangles has to match mesh->m_faces
 
-        int deleted_triangles = 0;
-        std::vector<int> deleted0,deleted1;
-        int triangle_count = triangles.size();
+    template <typename T, typename S>
+    void copy_level(Context &ctx, Mesh<T, S> *mesh, Mesh<T, S> &level) {
+        std::vector<int> index(mesh->m_vertices.size(), -1);
 
-        loop(iteration,0,1000)
-        {
-            // target number of triangles reached ? Then break
-            printf("iteration %d - triangles %d\n",iteration,triangle_count-deleted_triangles);
-            if(triangle_count-deleted_triangles<=target_count)break;
+        level.m_vertices.clear();
+        level.m_faces.clear();
 
-            // update mesh once in a while
-            if(iteration%1==0)
-            {
-                if(iteration > 0) {
-                    int dst = 0;
+        for (int i = 0; i < ctx.triangles.size(); i++) {
+            if (ctx.is_deleted(i)) continue;
 
-                    for (int i = 0; i < triangles.size(); i++)
-                        if(!triangles[i].deleted) {
-                            triangles[dst++]=triangles[i];
+            auto face = mesh->m_faces[i];
 
-                            mesh->m_faces.at(dst - 1) = mesh->m_faces.at(i);
-                        }
+            for (uint j = 0; j < 3; j++) {
+                uint &v = *(&face.v0 + j);
+
+                if (index[v] < 0) {
+                    index[v] = level.m_vertices.size();
+                    level.m_vertices.push_back(mesh->vertex(v));
+                }
+
+                v = static_cast<uint>(index[v]);
+            }
+
+            level.m_faces.push_back(face);
+        }
+    }
 
-                    triangles.resize(dst);
+    //
+    // Threshold sweep down to every count of targets, in descending order. The run goes on
+    // from one target to the next with its quadrics and threshold, levels receives a copy
+    // of the mesh at every target when set. A target that can't be reached gets the last mesh.
+    //
+    template <typename T, typename S>
+    void simplify_mesh_levels(Context &ctx, Mesh<T, S> *mesh, std::vector<int> const &targets, std::vector<Mesh<T, S>> *levels, double agressiveness=7) {
+        // init
+        if (!ctx.quiet) printf("%s - start\n",__FUNCTION__);
+        double time_start = ctx.stats.total_time();
+
+        import_mesh(ctx, mesh);
+        update_mesh(ctx);
+
+        // main iteration loop
+
+        int deleted_triangles = 0;
+        int triangle_count = ctx.triangles.size();
+        int level = 0;
+        int passes = 0;
+        ThresholdSchedule schedule;
+
+        // copy the levels down to the current count, true once the last one is reached
+        auto reached = [&]() {
+            while(level < targets.size() && triangle_count-deleted_triangles<=targets[level]) {
+                if (levels) {
+                    levels->emplace_back();
+                    copy_level(ctx, mesh, levels->back());
                 }
 
-                update_mesh(iteration);
+                level++;
             }
 
+            return level == targets.size();
+        };
+
+        loop(iteration,0,1000)
+        {
+            // target number of triangles reached ? Then break
+            if(reached())break;
+            if(!ctx.report(iteration,triangle_count-deleted_triangles))break;
+            ctx.stats.iterations++;
+            passes++;
+
+            Timer timer(ctx.stats.collapse_time);
+
             // clear dirty flag
-            for (int i = 0; i < triangles.size(); i++) {
-                triangles[i].dirty = 0;
+            for (int i = 0; i < ctx.flags.size(); i++) {
+                ctx.clear_dirty(i);
             }
 
             //
             // All triangles with edges below the threshold will be removed
             //
-            // The following numbers works well for most models.
-            // If it does not, try to adjust the 3 parameters
+            // The fixed numbers works well for most models.
+            // If they do not, try to adjust the 3 parameters or the adaptive schedule
             //
-            double threshold = 0.000000001*pow(double(iteration+3),agressiveness);
+            double threshold = schedule.next(ctx, iteration, triangle_count-deleted_triangles, targets[level], agressiveness);
 
             // remove vertices & mark deleted triangles
-            for (int i = 0; i < triangles.size(); i++)
+            bool collapsed = false;
+            bool pending = false;
+
+            for (int i = 0; i < ctx.triangles.size(); i++)
             {
-                Triangle &t=triangles[i];
-                if(t.err[3]>threshold) continue;
-                if(t.deleted) continue;
-                if(t.dirty) continue;
+                double min_error = ctx.min_error[i];
+                if(min_error>threshold) { pending = pending || (!ctx.is_deleted(i) && min_error <= ctx.max_error); continue; }
+                if(ctx.is_deleted(i)) continue;
+                if(ctx.is_dirty(i)) { ctx.stats.rejected_dirty++; continue; }
 
-                for (int j = 0; j < 3; j++) if(t.err[j] < threshold)
+                Triangle &t=ctx.triangles[i];
+
+                for (int j = 0; j < 3; j++) if(ctx.edges[t.e[j]].err < threshold && ctx.edges[t.e[j]].err <= ctx.max_error)
                     {
-                        int i0=t.v[ j     ]; Vertex &v0 = vertices[i0];
-                        int i1=t.v[(j+1)%3]; Vertex &v1 = vertices[i1];
+                        int i0=t.v[ j     ]; Vertex &v0 = ctx.vertices[i0];
+                        int i1=t.v[(j+1)%3]; Vertex &v1 = ctx.vertices[i1];
+                        ctx.stats.attempted++;
 
                         // Border check
-                        if(v0.border != v1.border)  continue;
+                        if(v0.border != v1.border) { ctx.stats.rejected_border++; continue; }
+                        if(ctx.is_locked(i0) || ctx.is_locked(i1)) { ctx.stats.rejected_locked++; continue; }
 
-                        // Compute vertex to collapse to
-                        vec3f p;
-                        calculate_error(i0,i1,p);
+                        // vertex to collapse to, kept with the edge
+                        vec3f p = ctx.edges[t.e[j]].p;
 
-                        deleted0.resize(v0.tcount); // normals temporarily
-                        deleted1.resize(v1.tcount); // normals temporarily
+                        ctx.scratch.deleted0.resize(v0.tcount); // normals temporarily
+                        ctx.scratch.deleted1.resize(v1.tcount); // normals temporarily
 
                         // don't remove if flipped
-                        if( flipped(p,i0,i1,v0,v1,deleted0) ) continue;
-                        if( flipped(p,i1,i0,v1,v0,deleted1) ) continue;
+                        if( flipped(ctx, p,i0,i1,v0,v1,ctx.scratch.deleted0) || flipped(ctx, p,i1,i0,v1,v0,ctx.scratch.deleted1) ) {
+                            ctx.stats.rejected_flip++;
+                            continue;
+                        }
 
                         // not flipped, so remove edge
-                        v0.p = p;
+                        ctx.stats.max_collapse_error = std::max(ctx.stats.max_collapse_error, ctx.edges[t.e[j]].err);
+                        collapse_edge(ctx, mesh, i0, i1, p, deleted_triangles, ctx.scratch);
+                        ctx.stats.collapses++;
+                        collapsed = true;
+                        break;
+                    }
+                // done? a level in between is copied without ending the pass
+                if(reached())break;
+            }
+
+            // every edge is below the threshold and none can be collapsed, e.g. locked ones
+            if(!collapsed && !pending) break;
+        }
+
+        for (; levels && level < targets.size(); level++) {
+            levels->emplace_back();
+            copy_level(ctx, mesh, levels->back());
+        }
+
+        // clean up mesh
+        compact_mesh(ctx, mesh);
 
-                        auto &_vp0 = mesh->m_vertices.at(i0).components.position;
-                        auto &_vp1 = mesh->m_vertices.at(i1).components.position;
+        // ready
+        if (!ctx.quiet) printf("%s - %d/%d %d%% removed in %d passes, %g s\n",__FUNCTION__,
+                               triangle_count-deleted_triangles,
+                               triangle_count,triangle_count ? deleted_triangles*100/triangle_count : 0,
+                               passes,ctx.stats.total_time()-time_start);
+    }
 
-                        mesh->m_vertices.at(i0).components.interpolate(mesh->m_vertices.at(i0).components, mesh->m_vertices.at(i1).components, glm::distance(_vp0, p) / glm::distance(_vp0, _vp1));
+    template <typename T, typename S>
+    void simplify_mesh(Context &ctx, Mesh<T, S> *mesh, int target_count, double agressiveness=7) {
+        simplify_mesh_levels<T, S>(ctx, mesh, {target_count}, nullptr, agressiveness);
+    }
 
-                        //mesh->m_vertices.at(i0).components.position = p;
-                        v0.q = v1.q + v0.q;
-                        int tstart=refs.size();
+    inline void build_heap(Context &ctx, Heap &heap) {
+        std::vector<HeapEntry> entries;
+        entries.reserve(ctx.triangles.size());
+        ctx.keys.resize(ctx.triangles.size());
 
-                        update_triangles(mesh, i0,v0,deleted0,deleted_triangles);
-                        update_triangles(mesh, i0,v1,deleted1,deleted_triangles);
+        for (int i = 0; i < ctx.triangles.size(); i++) {
+            if (ctx.is_deleted(i)) continue;
+
+            ctx.clear_dirty(i);
+            ctx.keys[i] = ctx.min_error[i];
+            entries.push_back(HeapEntry{ctx.min_error[i], i});
+        }
+
+        heap = Heap(std::greater<HeapEntry>(), std::move(entries));
+    }
+
+    //
+    // Greedy simplification down to every count of targets, in descending order: the
+    // cheapest valid edge is collapsed on every step. levels receives a copy of the mesh
+    // at every target when set, as in simplify_mesh_levels.
+    //
+    // Every live triangle has one valid entry keyed on its cheapest untried edge,
+    // superseded entries are dropped when popped. Edge errors mostly grow after a
+    // collapse, so a triangle is only requeued right away when its error drops,
+    // otherwise it is marked dirty and requeued with the new error once popped.
+    //
+    template <typename T, typename S>
+    void simplify_mesh_heap_levels(Context &ctx, Mesh<T, S> *mesh, std::vector<int> const &targets, std::vector<Mesh<T, S>> *levels) {
+        if (!ctx.quiet) printf("%s - start\n",__FUNCTION__);
+        double time_start = ctx.stats.total_time();
+
+        import_mesh(ctx, mesh);
+        update_mesh(ctx);
+
+        int deleted_triangles = 0;
+        int triangle_count = ctx.triangles.size();
+
+        Heap heap;
+
+        {
+            Timer timer(ctx.stats.init_time);
+            build_heap(ctx, heap);
+        }
+
+        // the heap is rebuilt in the loop now and then, that is timed on its own
+        auto loop_start = std::chrono::steady_clock::now();
+        double other_start = ctx.stats.total_time();
+
+        bool collapsed_since_build = false;
+        bool stuck = false;
+        int steps = 0;
+
+        for (int target_count : targets) {
+            while (!stuck && triangle_count - deleted_triangles > target_count) {
+                if ((++steps & 1023) == 0 && !ctx.report(steps, triangle_count - deleted_triangles)) {
+                    stuck = true;
+                    break;
+                }
 
-                        int tcount = refs.size() - tstart;
+                ctx.stats.iterations++;
 
-                        if(tcount <= v0.tcount) {
-                            // save ram
-                            if (tcount) {
-                                memcpy(&refs[v0.tstart], &refs[tstart], tcount * sizeof(Ref));
-                            }
+                if (heap.empty()) {
+                    // rejected edges may have become valid since, give them one more chance
+                    if (!collapsed_since_build) { stuck = true; break; }
+
+                    {
+                        Timer rebuild(ctx.stats.init_time);
+                        build_heap(ctx, heap);
+                    }
+
+                    collapsed_since_build = false;
+                    continue;
+                }
+
+                HeapEntry e = heap.top();
+                heap.pop();
+
+                // keys never exceed the errors they stand for, every edge left is above the bound
+                if(e.err > ctx.max_error) { stuck = true; break; }
+
+                if(ctx.is_deleted(e.tid)) continue;
+                if(e.err != ctx.keys[e.tid]) continue;
+
+                Triangle &t = ctx.triangles[e.tid];
+
+                if(ctx.is_dirty(e.tid)) {
+                    ctx.clear_dirty(e.tid);
+
+                    if(ctx.min_error[e.tid] != e.err) {
+                        ctx.keys[e.tid] = ctx.min_error[e.tid];
+                        heap.push(HeapEntry{ctx.min_error[e.tid], e.tid});
+                        ctx.stats.rejected_dirty++;
+                        continue;
+                    }
+                }
+
+                bool done = false;
+
+                for (int j = 0; j < 3 && !done; j++) {
+                    if (ctx.edges[t.e[j]].err != e.err) continue;
+
+                    int i0=t.v[ j     ]; Vertex &v0 = ctx.vertices[i0];
+                    int i1=t.v[(j+1)%3]; Vertex &v1 = ctx.vertices[i1];
+                    ctx.stats.attempted++;
+
+                    // Border check
+                    if(v0.border != v1.border) { ctx.stats.rejected_border++; continue; }
+                    if(ctx.is_locked(i0) || ctx.is_locked(i1)) { ctx.stats.rejected_locked++; continue; }
+
+                    // vertex to collapse to, kept with the edge
+                    vec3f p = ctx.edges[t.e[j]].p;
+
+                    ctx.scratch.deleted0.resize(v0.tcount);
+                    ctx.scratch.deleted1.resize(v1.tcount);
+
+                    if( flipped(ctx, p,i0,i1,v0,v1,ctx.scratch.deleted0) || flipped(ctx, p,i1,i0,v1,v0,ctx.scratch.deleted1) ) {
+                        ctx.stats.rejected_flip++;
+                        continue;
+                    }
+
+                    // don't go below the target, a border edge may still fit
+                    int removed = 0;
+
+                    for (int c = v0.corner, k = 0; c >= 0; c = ctx.next_corner[c], k++) {
+                        if (ctx.scratch.deleted0[k]) removed++;
+                    }
+
+                    if (triangle_count - deleted_triangles - removed < target_count) { ctx.stats.rejected_target++; continue; }
+
+                    ctx.stats.max_collapse_error = std::max(ctx.stats.max_collapse_error, e.err);
+                    collapse_edge(ctx, mesh, i0, i1, p, deleted_triangles, ctx.scratch);
+                    ctx.stats.collapses++;
+                    collapsed_since_build = true;
+                    done = true;
+
+                    // requeue the triangles around the new vertex
+                    for (int c = v0.corner; c >= 0; c = ctx.next_corner[c]) {
+                        int tid = c / 3;
+
+                        if (ctx.min_error[tid] < ctx.keys[tid]) {
+                            ctx.clear_dirty(tid);
+                            ctx.keys[tid] = ctx.min_error[tid];
+                            heap.push(HeapEntry{ctx.min_error[tid], tid});
                         }
-                        else {
-                            // append
-                            v0.tstart = tstart;
+                    }
+                }
+
+                if (done) continue;
+
+                // every edge with this error was rejected, move on to the next cheapest one
+                double next = -1;
+
+                for (int j = 0; j < 3; j++) {
+                    double err = ctx.edges[t.e[j]].err;
+                    if (err > e.err && (next < 0 || err < next)) next = err;
+                }
+
+                if (next >= 0) {
+                    ctx.keys[e.tid] = next;
+                    heap.push(HeapEntry{next, e.tid});
+                }
+            }
+
+            if (levels) {
+                levels->emplace_back();
+                copy_level(ctx, mesh, levels->back());
+            }
+        }
+
+        ctx.stats.collapse_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - loop_start).count()
+                                   - (ctx.stats.total_time() - other_start);
+
+        compact_mesh(ctx, mesh);
+
+        if (!ctx.quiet) printf("%s - %d/%d triangles in %g s\n",__FUNCTION__,triangle_count-deleted_triangles,triangle_count,
+                               ctx.stats.total_time()-time_start);
+    }
+
+    template <typename T, typename S>
+    void simplify_mesh_heap(Context &ctx, Mesh<T, S> *mesh, int target_count) {
+        simplify_mesh_heap_levels<T, S>(ctx, mesh, {target_count}, nullptr);
+    }
+
+    //
+    // Parallel simplification in rounds, with the thresholds of the sweep. A round sorts
+    // the edges below the threshold by error and takes the valid ones greedily as long as
+    // they keep clear of the edges taken before. The collapses of a round write disjoint
+    // parts of the mesh and are done on all threads in any order. The sets only depend on
+    // the mesh, so the result is the same for any thread count. The threshold goes up once
+    // a round collapses nothing. Collapses of concurrent threads can't be recorded, a run
+    // with ctx.record set is done by simplify_mesh_levels instead.
+    //
+    template <typename T, typename S>
+    void simplify_mesh_parallel_levels(Context &ctx, Mesh<T, S> *mesh, std::vector<int> const &targets, std::vector<Mesh<T, S>> *levels, double agressiveness=7) {
+        if (ctx.record) {
+            simplify_mesh_levels(ctx, mesh, targets, levels, agressiveness);
+            return;
+        }
+
+        if (!ctx.quiet) printf("%s - start\n",__FUNCTION__);
+        double time_start = ctx.stats.total_time();
+
+        import_mesh(ctx, mesh);
+        update_mesh(ctx);
+
+        unsigned int threads = thread_count(ctx.threads);
+        int deleted_triangles = 0;
+        int triangle_count = ctx.triangles.size();
+
+        std::vector<std::vector<Candidate>> proposed(threads);
+        std::vector<char> pending(threads);
+        std::vector<Candidate> candidates;
+        std::vector<int> chosen, removes;    // candidates taken in a round and the triangles they remove
+
+        // last round with a collapse at or next to a vertex, and with a removed triangle at it
+        std::vector<int> near(ctx.vertices.size(), -1);
+        std::vector<int> wings(ctx.vertices.size(), -1);
+
+        std::vector<Scratch> scratch(threads);
+        std::vector<Stats> thread_stats(threads);
+        std::vector<int> thread_deleted(threads);
+
+        Timer timer(ctx.stats.collapse_time);
+        int iteration = 0;
+        int round = 0;
+        int level = 0;
+        ThresholdSchedule schedule;
+        double threshold = 0;
+        bool raise = true;
+
+        // copy the levels down to the current count, true once the last one is reached
+        auto reached = [&]() {
+            while(level < targets.size() && triangle_count-deleted_triangles<=targets[level]) {
+                if (levels) {
+                    levels->emplace_back();
+                    copy_level(ctx, mesh, levels->back());
+                }
+
+                level++;
+            }
+
+            return level == targets.size();
+        };
+
+        while (!reached()) {
+            if (iteration == 1000 || !ctx.report(round, triangle_count - deleted_triangles)) break;
+
+            ctx.stats.iterations++;
+            round++;
+
+            if (raise) threshold = schedule.next(ctx, iteration, triangle_count - deleted_triangles, targets[level], agressiveness);
+            raise = false;
+
+            // the edges below the threshold, every thread proposes those of its triangles
+            for (unsigned int t = 0; t < threads; t++) {
+                proposed[t].clear();
+                pending[t] = 0;
+            }
+
+            parallel_for(ctx.workers(), 0, triangle_count, [&](unsigned int thread, int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    if (ctx.is_deleted(i)) continue;
+
+                    double min_error = ctx.min_error[i];
+                    if (min_error > threshold) { pending[thread] |= min_error <= ctx.max_error; continue; }
+
+                    Triangle &t = ctx.triangles[i];
+
+                    for (int j = 0; j < 3; j++) {
+                        double err = ctx.edges[t.e[j]].err;
+
+                        if (err < threshold && err <= ctx.max_error) proposed[thread].push_back(Candidate{err, t.e[j]});
+                    }
+                }
+            });
+
+            candidates.clear();
+
+            for (auto const &list : proposed) {
+                candidates.insert(candidates.end(), list.begin(), list.end());
+            }
+
+            // an edge is proposed by every triangle it has
+            std::sort(candidates.begin(), candidates.end());
+            candidates.erase(std::unique(candidates.begin(), candidates.end(), [](Candidate const &a, Candidate const &b) {
+                return a.edge == b.edge;
+            }), candidates.end());
+
+            //
+            // The cheapest valid edges whose ends are two edges or more away from those
+            // taken before. A collapse writes its ends, the triangles and edges around them
+            // and the rings of the third vertices of the removed triangles (wings), which
+            // must not be shared either. The other neighbours are only read, so a flip
+            // check holds until the round is done.
+            //
+            chosen.clear();
+            removes.clear();
+
+            for (int k = 0; k < candidates.size(); k++) {
+                Edge const &e = ctx.edges[candidates[k].edge];
+                int i0 = e.v0; Vertex &v0 = ctx.vertices[i0];
+                int i1 = e.v1; Vertex &v1 = ctx.vertices[i1];
+                ctx.stats.attempted++;
+
+                // Border check
+                if(v0.border != v1.border) { ctx.stats.rejected_border++; continue; }
+                if(ctx.is_locked(i0) || ctx.is_locked(i1)) { ctx.stats.rejected_locked++; continue; }
+
+                bool free = near[i0] != round && near[i1] != round;
+                int removed = 0;
+
+                for (int c = v0.corner; c >= 0 && free; c = ctx.next_corner[c]) {
+                    Triangle &t = ctx.triangles[c / 3];
+                    int s = c % 3;
+
+                    if (t.v[(s + 1) % 3] == i1 || t.v[(s + 2) % 3] == i1) {
+                        int wing = t.v[(s + 1) % 3] == i1 ? t.v[(s + 2) % 3] : t.v[(s + 1) % 3];
+
+                        if (wings[wing] == round) free = false;
+                        removed++;
+                    }
+                }
+
+                if (!free) { ctx.stats.rejected_overlap++; continue; }
+
+                ctx.scratch.deleted0.resize(v0.tcount);
+                ctx.scratch.deleted1.resize(v1.tcount);
+
+                if( flipped(ctx, e.p,i0,i1,v0,v1,ctx.scratch.deleted0) || flipped(ctx, e.p,i1,i0,v1,v0,ctx.scratch.deleted1) ) {
+                    ctx.stats.rejected_flip++;
+                    continue;
+                }
+
+                for (int i : {i0, i1}) {
+                    for (int c = ctx.vertices[i].corner; c >= 0; c = ctx.next_corner[c]) {
+                        Triangle &t = ctx.triangles[c / 3];
+                        int s = c % 3;
+
+                        near[t.v[(s + 1) % 3]] = round;
+                        near[t.v[(s + 2) % 3]] = round;
+
+                        if (i == i0 && (t.v[(s + 1) % 3] == i1 || t.v[(s + 2) % 3] == i1)) {
+                            wings[t.v[(s + 1) % 3] == i1 ? t.v[(s + 2) % 3] : t.v[(s + 1) % 3]] = round;
                         }
+                    }
+                }
 
-                        v0.tcount=tcount;
-                        break;
+                chosen.push_back(k);
+                removes.push_back(removed);
+            }
+
+            //
+            // Collapse the chosen edges in order up to the next target, like the sweep a
+            // collapse may go one triangle below it. The collapses don't depend on each
+            // other, so a level in between is copied without ending the round and a run
+            // with more targets gives the same levels as a run for each of them.
+            //
+            size_t collapses = ctx.stats.collapses;
+            int begin = 0;
+
+            while (begin < chosen.size() && !reached()) {
+                int end = begin;
+
+                for (int left = triangle_count - deleted_triangles; end < chosen.size() && left > targets[level]; end++) {
+                    left -= removes[end];
+                }
+
+                for (unsigned int t = 0; t < threads; t++) {
+                    thread_stats[t] = Stats();
+                    thread_deleted[t] = 0;
+                }
+
+                parallel_for(ctx.workers(), begin, end, [&](unsigned int thread, int begin, int end) {
+                    Scratch &s = scratch[thread];
+
+                    for (int k = begin; k < end; k++) {
+                        Edge const &e = ctx.edges[candidates[chosen[k]].edge];
+                        int i0 = e.v0; Vertex &v0 = ctx.vertices[i0];
+                        int i1 = e.v1; Vertex &v1 = ctx.vertices[i1];
+                        vec3f p = e.p;
+
+                        // fills deleted0/deleted1 of this thread, the check passed when it was chosen
+                        s.deleted0.resize(v0.tcount);
+                        s.deleted1.resize(v1.tcount);
+                        flipped(ctx, p,i0,i1,v0,v1,s.deleted0);
+                        flipped(ctx, p,i1,i0,v1,v0,s.deleted1);
+
+                        collapse_edge(ctx, mesh, i0, i1, p, thread_deleted[thread], s);
+                        thread_stats[thread].collapses++;
+                        thread_stats[thread].max_collapse_error = std::max(thread_stats[thread].max_collapse_error, candidates[chosen[k]].err);
                     }
-                // done?
-                if(triangle_count-deleted_triangles<=target_count)break;
+                }, 64);
+
+                for (unsigned int t = 0; t < threads; t++) {
+                    ctx.stats += thread_stats[t];
+                    deleted_triangles += thread_deleted[t];
+                }
+
+                begin = end;
+            }
+
+            // every edge below the threshold is rejected, try a larger one
+            if (ctx.stats.collapses == collapses) {
+                if (std::find(pending.begin(), pending.end(), 1) == pending.end()) break;
+
+                iteration++;
+                raise = true;
             }
         }
 
-        // clean up mesh
-        compact_mesh(mesh);
+        for (; levels && level < targets.size(); level++) {
+            levels->emplace_back();
+            copy_level(ctx, mesh, levels->back());
+        }
 
-        // ready
-//        int timeEnd=timeGetTime();
-//        printf("%s - %d/%d %d%% removed in %d ms\n",__FUNCTION__,
-//               triangle_count-deleted_triangles,
-//               triangle_count,deleted_triangles*100/triangle_count,
-//               timeEnd-timeStart);
+        timer.stop();
+
+        compact_mesh(ctx, mesh);
+
+        if (!ctx.quiet) printf("%s - %d/%d triangles in %d rounds, %g s\n",__FUNCTION__,triangle_count-deleted_triangles,triangle_count,round,
+                               ctx.stats.total_time()-time_start);
+    }
+
+    template <typename T, typename S>
+    void simplify_mesh_parallel(Context &ctx, Mesh<T, S> *mesh, int target_count, double agressiveness=7) {
+        simplify_mesh_parallel_levels<T, S>(ctx, mesh, {target_count}, nullptr, agressiveness);
+    }
+
+    //
+    // Parallel simplification for large meshes. Faces are split into spatial cells by
+    // a k-d split over their centroids, vertices shared between cells are locked and
+    // every cell is simplified with the threshold sweep on its own thread. The cells
+    // are stitched together and a last sweep over the whole mesh removes the seams.
+    //
+    template <typename T, typename S>
+    void simplify_mesh_partitioned(Context &ctx, Mesh<T, S> *mesh, int target_count, double agressiveness=7) {
+        if (!ctx.quiet) printf("%s - start\n",__FUNCTION__);
+        double time_start = ctx.stats.total_time();
+
+        unsigned int threads = thread_count(ctx.threads);
+        int face_count = mesh->m_faces.size();
+        int vertex_count = mesh->m_vertices.size();
+
+        // one cell per thread, rounded up to a power of two by the k-d split
+        int cell_count = 1;
+        while (cell_count < static_cast<int>(threads) && face_count / (cell_count * 2) >= 4096) cell_count *= 2;
+
+        // the inner runs are quiet, the cells would log at the same time
+        bool quiet = ctx.quiet;
+
+        if (cell_count == 1) {
+            ctx.quiet = true;
+            simplify_mesh(ctx, mesh, target_count, agressiveness);
+            ctx.quiet = quiet;
+
+            if (!ctx.quiet) printf("%s - %d/%d triangles in 1 cell, %g s\n",__FUNCTION__,static_cast<int>(mesh->m_faces.size()),face_count,
+                                   ctx.stats.total_time()-time_start);
+            return;
+        }
+
+        if (!ctx.report(0, face_count)) return;
+
+        std::vector<vec3f> centroids(face_count);
+
+        for (int i = 0; i < face_count; i++) {
+            auto const &f = mesh->m_faces[i];
+            centroids[i] = (mesh->position(f.v0) + mesh->position(f.v1)
+                            + mesh->position(f.v2)) / 3.f;
+        }
+
+        std::vector<int> order(face_count);
+        std::iota(order.begin(), order.end(), 0);
+
+        // split every cell at the median of its longest axis
+        std::vector<int> bounds = {0, face_count};
+
+        for (int cells = 1; cells < cell_count; cells *= 2) {
+            std::vector<int> next = {0};
+
+            for (int c = 0; c < cells; c++) {
+                auto begin = order.begin() + bounds[c];
+                auto end = order.begin() + bounds[c + 1];
+
+                vec3f lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+
+                for (auto it = begin; it != end; ++it) {
+                    lo = glm::min(lo, centroids[*it]);
+                    hi = glm::max(hi, centroids[*it]);
+                }
+
+                vec3f extent = hi - lo;
+                int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+                auto mid = begin + (end - begin) / 2;
+
+                std::nth_element(begin, mid, end, [&centroids, axis](int a, int b) {
+                    return centroids[a][axis] < centroids[b][axis];
+                });
+
+                next.push_back(static_cast<int>(mid - order.begin()));
+                next.push_back(bounds[c + 1]);
+            }
+
+            bounds = std::move(next);
+        }
+
+        // lock the vertices used by more than one cell
+        std::vector<int> vertex_cell(vertex_count, -1);
+        std::vector<char> locked(vertex_count, 0);
+
+        for (int c = 0; c < cell_count; c++) {
+            for (int i = bounds[c]; i < bounds[c + 1]; i++) {
+                auto const &f = mesh->m_faces[order[i]];
+
+                for (uint j = 0; j < 3; j++) {
+                    int v = *(&f.v0 + j);
+
+                    if (vertex_cell[v] < 0) vertex_cell[v] = c;
+                    else if (vertex_cell[v] != c) locked[v] = 1;
+                }
+            }
+        }
+
+        // simplify the cells, globals maps the vertices of a cell to the mesh
+        std::vector<Mesh<T, S>> cells(cell_count);
+        std::vector<std::vector<int>> globals(cell_count);
+        std::vector<std::vector<int>> remaps(cell_count);
+        std::vector<Stats> cell_stats(cell_count);
+
+        // every cell counts on its own, the parent sees the sums
+        std::vector<Progress> cell_progress(ctx.progress ? cell_count : 0);
+
+        parallel_for(ctx.workers(), 0, cell_count, [&](unsigned int, int begin, int end) {
+            for (int c = begin; c < end; c++) {
+                Mesh<T, S> &cell = cells[c];
+                std::vector<int> &global = globals[c];
+
+                global.reserve(3 * (bounds[c + 1] - bounds[c]));
+                cell.m_faces.reserve(bounds[c + 1] - bounds[c]);
+
+                for (int i = bounds[c]; i < bounds[c + 1]; i++) {
+                    auto const &f = mesh->m_faces[order[i]];
+                    global.insert(global.end(), {static_cast<int>(f.v0), static_cast<int>(f.v1), static_cast<int>(f.v2)});
+                }
+
+                std::sort(global.begin(), global.end());
+                global.erase(std::unique(global.begin(), global.end()), global.end());
+
+                Context cell_ctx;
+                cell_ctx.threads = 1;
+                cell_ctx.quiet = true;
+                cell_ctx.attribute_weight = ctx.attribute_weight;
+                cell_ctx.max_error = ctx.max_error;
+                cell_ctx.schedule = ctx.schedule;
+                cell_ctx.schedule_share = ctx.schedule_share;
+                cell_ctx.locked.resize(global.size());
+                cell.m_vertices.reserve(global.size());
+
+                for (int i = 0; i < global.size(); i++) {
+                    cell.m_vertices.push_back(mesh->vertex(global[i]));
+                    cell_ctx.locked[i] = locked[global[i]];
+                }
+
+                for (int i = bounds[c]; i < bounds[c + 1]; i++) {
+                    auto f = mesh->m_faces[order[i]];
+
+                    for (uint j = 0; j < 3; j++) {
+                        uint &v = *(&f.v0 + j);
+                        v = static_cast<uint>(std::lower_bound(global.begin(), global.end(), static_cast<int>(v)) - global.begin());
+                    }
+
+                    cell.m_faces.push_back(f);
+                }
+
+                if (ctx.progress) {
+                    cell_progress[c].triangles = static_cast<int>(cell.m_faces.size());
+                    cell_progress[c].parent = ctx.progress;
+                    cell_ctx.progress = &cell_progress[c];
+                }
+
+                // a collapse removes two faces, keep them so the seam pass lands on the target
+                int cell_target = static_cast<int>(static_cast<long long>(cell.m_faces.size()) * target_count / face_count) + 2;
+
+                simplify_mesh(cell_ctx, &cell, cell_target, agressiveness);
+
+                // the last pass may remove faces after its report
+                if (ctx.progress) cell_progress[c].publish(cell_progress[c].iteration, static_cast<int>(cell.m_faces.size()));
+                remaps[c] = std::move(cell_ctx.remap);
+                cell_stats[c] = cell_ctx.stats;
+            }
+        }, 1);
+
+        for (auto const &stats : cell_stats) {
+            ctx.stats += stats;
+        }
+
+        // stitch the cells, locked vertices are unchanged and shared between them
+        std::vector<int> shared(vertex_count, -1);
+
+        mesh->m_vertices.clear();
+        mesh->m_faces.clear();
+
+        for (int c = 0; c < cell_count; c++) {
+            Mesh<T, S> &cell = cells[c];
+            std::vector<int> index(cell.m_vertices.size(), -1);
+
+            for (int i = 0; i < remaps[c].size(); i++) {
+                int v = remaps[c][i];
+                if (v < 0) continue;
+
+                int g = globals[c][i];
+
+                if (!locked[g]) {
+                    index[v] = mesh->m_vertices.size();
+                    mesh->m_vertices.push_back(cell.vertex(v));
+                }
+                else {
+                    if (shared[g] < 0) {
+                        shared[g] = mesh->m_vertices.size();
+                        mesh->m_vertices.push_back(cell.vertex(v));
+                    }
+
+                    index[v] = shared[g];
+                }
+            }
+
+            for (auto f : cell.m_faces) {
+                for (uint j = 0; j < 3; j++) {
+                    uint &v = *(&f.v0 + j);
+                    v = static_cast<uint>(index[v]);
+                }
+
+                mesh->m_faces.push_back(f);
+            }
+
+            cell = Mesh<T, S>();
+        }
+
+        //
+        // An error bounded run only collapses the seams, the seam pass builds its quadrics
+        // from the simplified cells and would spend the bound on them a second time.
+        //
+        std::vector<char> locks;
+
+        if (ctx.max_error < std::numeric_limits<double>::infinity()) {
+            locks.assign(mesh->m_vertices.size(), 1);
+
+            for (int v : shared) {
+                if (v >= 0) locks[v] = 0;
+            }
+        }
+
+        // seam pass
+        std::swap(ctx.locked, locks);
+        ctx.quiet = true;
+        simplify_mesh(ctx, mesh, target_count, agressiveness);
+        ctx.quiet = quiet;
+        std::swap(ctx.locked, locks);
+
+        if (!ctx.quiet) printf("%s - %d/%d triangles in %d cells, %g s\n",__FUNCTION__,static_cast<int>(mesh->m_faces.size()),face_count,cell_count,
+                               ctx.stats.total_time()-time_start);
+    }
+
+    //
+    // Vertex clustering: vertices are snapped to a uniform grid and every occupied cell
+    // becomes one vertex, placed at the minimum of the summed quadrics of its faces when
+    // that lies in the cell and at the mean of its vertices otherwise. Faces with two
+    // corners in one cell and copies of a face on the same cells are dropped. Every pass
+    // is linear, the cell size starts from
+    // the surface area and is refined a few times to get close to target_count.
+    //
+    template <typename T, typename S>
+    void simplify_mesh_clustering(Context &ctx, Mesh<T, S> *mesh, int target_count) {
+        if (!ctx.quiet) printf("%s - start\n",__FUNCTION__);
+
+        int vertex_count = mesh->m_vertices.size();
+        int face_count = mesh->m_faces.size();
+
+        if (face_count <= target_count || target_count <= 0) return;
+
+        double time_start = ctx.stats.total_time();
+        Timer timer(ctx.stats.init_time);
+
+        vec3f lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+        double area = 0;
+
+        for (int i = 0; i < vertex_count; i++) {
+            lo = glm::min(lo, mesh->position(i));
+            hi = glm::max(hi, mesh->position(i));
+        }
+
+        for (auto const &face : mesh->m_faces) {
+            vec3f const &p0 = mesh->position(face.v0);
+            area += 0.5 * glm::length(glm::cross(mesh->position(face.v1) - p0,
+                                                 mesh->position(face.v2) - p0));
+        }
+
+        std::vector<int> cells(vertex_count);
+        std::vector<unsigned long long> keys(vertex_count);
+        int cell_count = 0;
+
+        // cell of every vertex for the given cell size, returns the faces that are left
+        auto cluster = [&](double cell_size) {
+            double max_cells = static_cast<double>((1 << 21) - 1);
+            vec3f size = vec3f(static_cast<float>(glm::max(cell_size, glm::max(glm::max(hi.x - lo.x, hi.y - lo.y), hi.z - lo.z) / max_cells)));
+
+            parallel_for(ctx.workers(), 0, vertex_count, [&](unsigned int, int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    glm::uvec3 c(glm::max((mesh->position(i) - lo) / size, vec3f(0.f)));
+
+                    keys[i] = (static_cast<unsigned long long>(c.x) << 42) | (static_cast<unsigned long long>(c.y) << 21) | c.z;
+                }
+            });
+
+            std::unordered_map<unsigned long long, int> ids;
+            ids.reserve(vertex_count);
+
+            for (int i = 0; i < vertex_count; i++) {
+                cells[i] = ids.emplace(keys[i], static_cast<int>(ids.size())).first->second;
+            }
+
+            cell_count = ids.size();
+
+            int faces = 0;
+
+            for (auto const &face : mesh->m_faces) {
+                int c0 = cells[face.v0], c1 = cells[face.v1], c2 = cells[face.v2];
+                if (c0 != c1 && c1 != c2 && c2 != c0) faces++;
+            }
+
+            return faces;
+        };
+
+        // a surface has about two faces per occupied cell, the face count scales with 1 / size^2
+        double cell_size = std::sqrt(2 * area / target_count);
+        double best_size = cell_size;
+        int best_faces = -1;
+
+        // coarsest size leaving more faces than the target, finest size leaving none
+        double above_size = 0;
+        double empty_size = std::numeric_limits<double>::infinity();
+
+        timer.restart(ctx.stats.collapse_time);
+
+        // a small mesh can go from above the target to no faces in one step, bisect then
+        for (int probe = 0; probe < 4 || (best_faces < 0 && probe < 16); probe++) {
+            int faces = cluster(cell_size);
+            if (!ctx.report(probe, faces)) return;
+            ctx.stats.iterations++;
+
+            // the target is above 0, a size leaving no faces is never taken
+            bool empty = faces == 0;
+
+            if (faces <= target_count && !empty && faces > best_faces) {
+                best_size = cell_size;
+                best_faces = faces;
+            }
+
+            if (faces == target_count) break;
+
+            if (empty) empty_size = glm::min(empty_size, cell_size);
+            else if (faces > target_count) above_size = glm::max(above_size, cell_size);
+
+            double next = empty ? cell_size / 2 : cell_size * std::sqrt(faces / static_cast<double>(target_count));
+
+            // stay between the sizes known to leave too many and no faces
+            if (next <= above_size) next = std::sqrt(above_size * cell_size);
+            else if (next >= empty_size) next = std::sqrt(above_size * empty_size);
+
+            cell_size = next;
+        }
+
+        // none was between one face and the target, take the coarsest size that leaves faces
+        if (best_faces < 0) best_size = above_size > 0 ? above_size : cell_size;
+
+        cluster(best_size);
+
+        // representative of every cell
+        std::vector<SymetricMatrix> q(cell_count);
+        std::vector<vec3f> sum(cell_count, vec3f(0.f));
+        std::vector<int> count(cell_count, 0);
+
+        for (auto const &face : mesh->m_faces) {
+            vec3f const &p0 = mesh->position(face.v0);
+            vec3f n = glm::cross(mesh->position(face.v1) - p0, mesh->position(face.v2) - p0);
+            float length = glm::length(n);
+
+            if (length == 0) continue;
+
+            n /= length;
+            SymetricMatrix plane(n.x, n.y, n.z, -glm::dot(n, p0));
+
+            int c0 = cells[face.v0], c1 = cells[face.v1], c2 = cells[face.v2];
+
+            q[c0] += plane;
+            if (c1 != c0) q[c1] += plane;
+            if (c2 != c0 && c2 != c1) q[c2] += plane;
+        }
+
+        for (int i = 0; i < vertex_count; i++) {
+            sum[cells[i]] += mesh->position(i);
+            count[cells[i]]++;
+        }
+
+        std::vector<vec3f> position(cell_count);
+        vec3f size(static_cast<float>(best_size));
+
+        parallel_for(ctx.workers(), 0, cell_count, [&](unsigned int, int begin, int end) {
+            for (int c = begin; c < end; c++) {
+                vec3f mean = sum[c] / static_cast<float>(count[c]);
+                double x, y, z;
+
+                position[c] = mean;
+
+                // a near singular quadric places the vertex far away, keep it close to the cell
+                if (q[c].solve(x, y, z) != 0) {
+                    vec3f p(x, y, z);
+
+                    if (glm::all(glm::lessThanEqual(glm::abs(p - mean), size))) {
+                        position[c] = p;
+                    }
+                }
+            }
+        });
+
+        // attributes come from the vertex closest to the representative
+        std::vector<int> nearest(cell_count, -1);
+        std::vector<float> distance(cell_count, std::numeric_limits<float>::max());
+
+        for (int i = 0; i < vertex_count; i++) {
+            int c = cells[i];
+            float d = glm::distance(mesh->position(i), position[c]);
+
+            if (d < distance[c]) {
+                distance[c] = d;
+                nearest[c] = i;
+            }
+        }
+
+        //
+        // Drop the degenerate faces and all but the first face on the same three cells,
+        // which would be coincident, the cells they leave unused are dropped as well.
+        //
+        timer.restart(ctx.stats.compact_time);
+
+        struct CellTriple {
+            int c[3];
+
+            bool operator==(CellTriple const &other) const {
+                return c[0] == other.c[0] && c[1] == other.c[1] && c[2] == other.c[2];
+            }
+        };
+
+        struct CellTripleHash {
+            size_t operator()(CellTriple const &t) const {
+                unsigned long long h = static_cast<unsigned>(t.c[0]);
+                h = h * 0x9E3779B97F4A7C15ull + static_cast<unsigned>(t.c[1]);
+                h = h * 0x9E3779B97F4A7C15ull + static_cast<unsigned>(t.c[2]);
+                return static_cast<size_t>(h ^ (h >> 32));
+            }
+        };
+
+        std::unordered_set<CellTriple, CellTripleHash> kept;
+        kept.reserve(mesh->m_faces.size());
+
+        std::vector<int> index(cell_count, -1);
+        decltype(mesh->m_vertices) vertices;
+        uint dst = 0;
+
+        for (uint i = 0; i < mesh->m_faces.size(); i++) {
+            auto face = mesh->m_faces[i];
+            int c0 = cells[face.v0], c1 = cells[face.v1], c2 = cells[face.v2];
+
+            if (c0 == c1 || c1 == c2 || c2 == c0) continue;
+
+            // either winding of the same cells is a copy
+            CellTriple triple{{c0, c1, c2}};
+            std::sort(triple.c, triple.c + 3);
+
+            if (!kept.insert(triple).second) continue;
+
+            for (uint j = 0; j < 3; j++) {
+                uint &v = *(&face.v0 + j);
+                int c = cells[v];
+
+                if (index[c] < 0) {
+                    index[c] = vertices.size();
+                    auto vertex = mesh->vertex(nearest[c]);
+                    vertex.components.position = position[c];
+                    vertices.push_back(vertex);
+                }
+
+                v = static_cast<uint>(index[c]);
+            }
+
+            mesh->m_faces[dst++] = face;
+        }
+
+        mesh->m_faces.resize(dst);
+        mesh->m_vertices = std::move(vertices);
+        timer.stop();
 
+        if (!ctx.quiet) printf("%s - %d/%d triangles in %g s\n",__FUNCTION__,static_cast<int>(dst),face_count,ctx.stats.total_time()-time_start);
     }
 };
 ///////////////////////////////////////////
@@ -0,0 +1,287 @@
+#include "StreamSimplify.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+
+namespace Simplify {
+
+    namespace {
+
+        const int grid_bits = 6;
+        const int grid_size = 1 << grid_bits;
+
+        struct StreamFace {
+            uint v[3];
+            int uv[3];
+        };
+
+        // Interleave the bits of x, y and z
+
+        uint morton_code(uint x, uint y, uint z) {
+            uint code = 0;
+
+            for (int i = 0; i < grid_bits; i++) {
+                code |= ((x >> i) & 1u) << (3 * i);
+                code |= ((y >> i) & 1u) << (3 * i + 1);
+                code |= ((z >> i) & 1u) << (3 * i + 2);
+            }
+
+            return code;
+        }
+
+        //
+        // Fixed size records of a binary file read in ascending id order, the file is
+        // read in blocks so every block is read at most once.
+        //
+        template <typename TRecord>
+        class RecordReader {
+            std::ifstream m_file;
+            std::vector<TRecord> m_block;
+            uint m_block_begin = 0;
+
+            static const uint block_size = 4096;
+
+        public:
+            explicit RecordReader(std::string const &fileName) : m_file(fileName, std::ios::binary) {}
+
+            TRecord const &at(uint id) {
+                if (m_block.empty() || id < m_block_begin || id >= m_block_begin + m_block.size()) {
+                    m_block_begin = id - id % block_size;
+                    m_block.resize(block_size);
+
+                    m_file.clear();
+                    m_file.seekg(static_cast<std::streamoff>(m_block_begin) * sizeof(TRecord));
+                    m_file.read(reinterpret_cast<char *>(m_block.data()), block_size * sizeof(TRecord));
+                    m_block.resize(static_cast<size_t>(m_file.gcount()) / sizeof(TRecord));
+                }
+
+                return m_block[id - m_block_begin];
+            }
+        };
+
+    }
+
+
+    StreamSource::~StreamSource() {
+        for (auto const &file : m_files) {
+            std::remove(file.c_str());
+        }
+    }
+
+    std::string StreamSource::file_name(std::string const &name) {
+        m_files.push_back(m_prefix + "." + name);
+
+        return m_files.back();
+    }
+
+    bool StreamSource::open(std::string const &fileName, int chunk_faces) {
+        std::string vertices_file = file_name("vertices");
+        std::string uvs_file = file_name("uvs");
+        std::string faces_file = file_name("faces");
+
+        // spill the input to binary files, only the bounding box is kept
+        {
+            std::ofstream vertices(vertices_file, std::ios::binary);
+            std::ofstream uvs(uvs_file, std::ios::binary);
+            std::ofstream faces(faces_file, std::ios::binary);
+
+            bool read;
+
+            try {
+                read = OBJReader::stream(fileName, [&](glm::vec3 const &position, glm::vec4 const &color, bool has_color) {
+                    StreamVertex vertex{position, color};
+                    vertices.write(reinterpret_cast<char const *>(&vertex), sizeof(vertex));
+
+                    m_has_color = m_has_color || has_color;
+                    m_vertex_count++;
+                }, [&](glm::vec2 const &uv) {
+                    uvs.write(reinterpret_cast<char const *>(&uv), sizeof(uv));
+                    m_uv_count++;
+                }, [&](uint const *v, int const *uv) {
+                    StreamFace face{{v[0], v[1], v[2]}, {uv[0], uv[1], uv[2]}};
+                    faces.write(reinterpret_cast<char const *>(&face), sizeof(face));
+                    m_face_count++;
+                });
+            }
+            catch (std::exception const &) {
+                // std::stoul and friends on a field that isn't a number
+                std::cerr << fileName << " has a malformed line after " << m_face_count << " faces" << std::endl;
+                return false;
+            }
+
+            if (!read) {
+                return false;
+            }
+        }
+
+        // grid cell of every vertex, the grid covers the bounding box
+
+        vec3f lo(std::numeric_limits<float>::max());
+        vec3f hi(-std::numeric_limits<float>::max());
+
+        {
+            std::ifstream vertices(vertices_file, std::ios::binary);
+            StreamVertex vertex;
+
+            while (vertices.read(reinterpret_cast<char *>(&vertex), sizeof(vertex))) {
+                lo = glm::min(lo, vertex.position);
+                hi = glm::max(hi, vertex.position);
+            }
+        }
+
+        vec3f scale = static_cast<float>(grid_size) / glm::max(hi - lo, vec3f(1e-20f));
+
+        m_vertex_chunk.resize(m_vertex_count);
+        std::vector<uint> cell_vertices(grid_size * grid_size * grid_size, 0);
+
+        {
+            std::ifstream vertices(vertices_file, std::ios::binary);
+            StreamVertex vertex;
+
+            for (uint i = 0; i < m_vertex_count && vertices.read(reinterpret_cast<char *>(&vertex), sizeof(vertex)); i++) {
+                glm::ivec3 cell = glm::clamp(glm::ivec3((vertex.position - lo) * scale), 0, grid_size - 1);
+                uint code = morton_code(cell.x, cell.y, cell.z);
+
+                m_vertex_chunk[i] = static_cast<int>(code);
+                cell_vertices[code]++;
+            }
+        }
+
+        // cut the Morton order into chunks, a closed mesh has about two faces per vertex
+
+        std::vector<int> cell_chunk(cell_vertices.size());
+        uint chunk_vertices = static_cast<uint>(glm::max(chunk_faces / 2, 1));
+
+        // every chunk has an open file while bucketing, keep them below the usual limits
+        chunk_vertices = glm::max(chunk_vertices, m_vertex_count / 256 + 1);
+
+        uint count = 0;
+        int chunks = 0;
+
+        for (uint code = 0; code < cell_vertices.size(); code++) {
+            if (count >= chunk_vertices) {
+                chunks++;
+                count = 0;
+            }
+
+            cell_chunk[code] = chunks;
+            count += cell_vertices[code];
+        }
+
+        chunks++;
+
+        for (auto &chunk : m_vertex_chunk) {
+            chunk = cell_chunk[chunk];
+        }
+
+        // bucket the faces, a vertex used by faces of two chunks is locked
+
+        m_vertex_owner.assign(m_vertex_count, -1);
+        m_locked.assign(m_vertex_count, 0);
+        m_chunk_faces.assign(chunks, 0);
+
+        {
+            std::vector<std::ofstream> buckets;
+
+            for (int c = 0; c < chunks; c++) {
+                buckets.emplace_back(file_name("chunk" + std::to_string(c)), std::ios::binary);
+            }
+
+            std::ifstream faces(faces_file, std::ios::binary);
+            StreamFace face;
+            uint face_id = 0;
+
+            while (faces.read(reinterpret_cast<char *>(&face), sizeof(face))) {
+                // negative (relative) ids are not supported and wrap around to large ones
+                for (uint j = 0; j < 3; j++) {
+                    if (face.v[j] >= m_vertex_count || face.uv[j] < -1 || face.uv[j] >= static_cast<int>(m_uv_count)) {
+                        std::cerr << "face " << face_id + 1 << " of " << fileName << " uses a vertex or uv that doesn't exist" << std::endl;
+                        return false;
+                    }
+                }
+
+                face_id++;
+
+                int chunk = m_vertex_chunk[face.v[0]];
+
+                for (uint v : face.v) {
+                    if (m_vertex_owner[v] < 0) m_vertex_owner[v] = chunk;
+                    else if (m_vertex_owner[v] != chunk) m_locked[v] = 1;
+                }
+
+                buckets[chunk].write(reinterpret_cast<char const *>(&face), sizeof(face));
+                m_chunk_faces[chunk]++;
+            }
+        }
+
+        m_vertex_chunk = std::vector<int>();
+        m_vertex_owner = std::vector<int>();
+
+        return true;
+    }
+
+    void StreamSource::load_chunk(int chunk, std::vector<int> &globals, std::vector<StreamVertex> &vertices, std::vector<Face> &faces) {
+        std::vector<StreamFace> chunk_faces(m_chunk_faces[chunk]);
+
+        {
+            std::ifstream file(m_prefix + ".chunk" + std::to_string(chunk), std::ios::binary);
+            file.read(reinterpret_cast<char *>(chunk_faces.data()), chunk_faces.size() * sizeof(StreamFace));
+        }
+
+        globals.clear();
+
+        for (auto const &face : chunk_faces) {
+            globals.insert(globals.end(), {static_cast<int>(face.v[0]), static_cast<int>(face.v[1]), static_cast<int>(face.v[2])});
+        }
+
+        std::sort(globals.begin(), globals.end());
+        globals.erase(std::unique(globals.begin(), globals.end()), globals.end());
+
+        RecordReader<StreamVertex> vertex_reader(m_prefix + ".vertices");
+
+        vertices.resize(globals.size());
+
+        for (int i = 0; i < globals.size(); i++) {
+            vertices[i] = vertex_reader.at(static_cast<uint>(globals[i]));
+        }
+
+        // uvs are read in ascending order as well
+        std::vector<int> uv_ids;
+
+        for (auto const &face : chunk_faces) {
+            for (int uv : face.uv) {
+                if (uv >= 0) uv_ids.push_back(uv);
+            }
+        }
+
+        std::sort(uv_ids.begin(), uv_ids.end());
+        uv_ids.erase(std::unique(uv_ids.begin(), uv_ids.end()), uv_ids.end());
+
+        std::vector<glm::vec2> uvs(uv_ids.size());
+        RecordReader<glm::vec2> uv_reader(m_prefix + ".uvs");
+
+        for (int i = 0; i < uv_ids.size(); i++) {
+            uvs[i] = uv_reader.at(static_cast<uint>(uv_ids[i]));
+        }
+
+        faces.resize(chunk_faces.size());
+
+        for (int i = 0; i < chunk_faces.size(); i++) {
+            auto const &face = chunk_faces[i];
+
+            for (uint j = 0; j < 3; j++) {
+                *(&faces[i].v0 + j) = static_cast<uint>(std::lower_bound(globals.begin(), globals.end(), static_cast<int>(face.v[j])) - globals.begin());
+
+                glm::vec2 uv(0.f);
+
+                if (face.uv[j] >= 0) {
+                    uv = uvs[std::lower_bound(uv_ids.begin(), uv_ids.end(), face.uv[j]) - uv_ids.begin()];
+                }
+
+                *(&faces[i].uv0 + j) = uv;
+            }
+        }
+    }
+
+}
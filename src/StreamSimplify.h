@@ -0,0 +1,230 @@
+#ifndef MESHSIMPLIFICATION_STREAMSIMPLIFY_H
+#define MESHSIMPLIFICATION_STREAMSIMPLIFY_H
+
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Mesh.h"
+#include "Simplify.h"
+
+
+namespace Simplify {
+
+    struct StreamOptions {
+        // faces simplified at once, bounds the memory used
+        int chunk_faces = 1 << 20;
+        // worker threads of every chunk, 0 means one per hardware thread
+        unsigned int threads = 0;
+        double agressiveness = 7;
+        // temporary files are named <temp_prefix>.<name>, next to the output when empty
+        std::string temp_prefix;
+    };
+
+    struct StreamVertex {
+        vec3f position;
+        glm::vec4 color;
+    };
+
+    //
+    // OBJ file spilled to binary temporary files and split into spatially coherent
+    // chunks. Vertices are bucketed on a 64^3 grid over the bounding box, grid cells
+    // are walked in Morton order and cut into chunks of about chunk_faces faces, a
+    // face goes to the chunk of its first vertex. Apart from the chunk being loaded
+    // only a chunk id and a lock flag per vertex are kept in memory.
+    //
+    class StreamSource {
+        std::string m_prefix;
+        std::vector<std::string> m_files;
+
+        uint m_vertex_count = 0;
+        uint m_uv_count = 0;
+        uint m_face_count = 0;
+        bool m_has_color = false;
+
+        std::vector<int> m_vertex_chunk;
+        std::vector<int> m_vertex_owner;
+        std::vector<char> m_locked;
+        std::vector<uint> m_chunk_faces;
+
+    public:
+        explicit StreamSource(std::string const &temp_prefix) : m_prefix(temp_prefix) {}
+        ~StreamSource();
+
+        StreamSource(StreamSource const &) = delete;
+        StreamSource &operator=(StreamSource const &) = delete;
+
+        bool open(std::string const &fileName, int chunk_faces);
+
+        int chunk_count() const {
+            return static_cast<int>(m_chunk_faces.size());
+        }
+
+        uint face_count() const {
+            return m_face_count;
+        }
+
+        uint chunk_face_count(int chunk) const {
+            return m_chunk_faces[chunk];
+        }
+
+        bool has_uv() const {
+            return m_uv_count != 0;
+        }
+
+        bool has_color() const {
+            return m_has_color;
+        }
+
+        // vertex used by more than one chunk
+
+        bool locked(int v) const {
+            return m_locked[v] != 0;
+        }
+
+        //
+        // Faces of a chunk with local vertex ids and their uvs. globals are the sorted
+        // ids of the vertices they use, vertices holds their data in the same order.
+        //
+        void load_chunk(int chunk, std::vector<int> &globals, std::vector<StreamVertex> &vertices, std::vector<Face> &faces);
+
+    private:
+        std::string file_name(std::string const &name);
+    };
+
+
+    //
+    // Simplify an OBJ file that may not fit in memory to about ratio of its faces and
+    // write the result to output. Chunks are simplified one after the other with the
+    // vertices they share locked, so chunk seams keep their input resolution.
+    // TVertexComponents needs position, normal, color and uv like VertexComponentsColored.
+    //
+    template <typename T>
+    bool simplify_file(std::string const &input, std::string const &output, float ratio, StreamOptions const &options) {
+        StreamSource source(options.temp_prefix.empty() ? output : options.temp_prefix);
+
+        if (!source.open(input, options.chunk_faces)) {
+            std::cerr << "can't read " << input << std::endl;
+            return false;
+        }
+
+        std::ofstream fout(output);
+
+        if (!fout.is_open()) {
+            std::cerr << "can't write " << output << std::endl;
+            return false;
+        }
+
+        // output ids of the locked vertices, they are written by the first chunk using them
+        std::unordered_map<int, uint> shared;
+        uint written = 0;
+        uint written_uvs = 0;
+
+        std::vector<int> globals;
+        std::vector<StreamVertex> vertices;
+        std::vector<Face> faces;
+
+        for (int c = 0; c < source.chunk_count(); c++) {
+            source.load_chunk(c, globals, vertices, faces);
+
+            if (faces.empty()) continue;
+
+            Mesh<T> chunk;
+            Context ctx;
+            ctx.threads = options.threads;
+            ctx.locked.resize(globals.size());
+
+            chunk.m_vertices.resize(vertices.size());
+
+            for (int i = 0; i < vertices.size(); i++) {
+                auto &components = chunk.m_vertices[i].components;
+
+                components.position = vertices[i].position;
+                components.normal = vec3f(0.f);
+                components.color = vertices[i].color;
+                components.uv = glm::vec2(0.f);
+
+                ctx.locked[i] = source.locked(globals[i]);
+            }
+
+            // like OBJReader the vertex uv is the one of its last corner
+            for (auto const &face : faces) {
+                for (uint j = 0; j < 3; j++) {
+                    chunk.m_vertices[*(&face.v0 + j)].components.uv = *(&face.uv0 + j);
+                }
+            }
+
+            chunk.m_faces = std::move(faces);
+
+            simplify_mesh(ctx, &chunk, static_cast<int>(ratio * chunk.m_faces.size()), options.agressiveness);
+
+            // new ids of the remaining chunk vertices in the output file
+            std::vector<uint> index(chunk.m_vertices.size());
+
+            for (int i = 0; i < ctx.remap.size(); i++) {
+                int v = ctx.remap[i];
+                if (v < 0) continue;
+
+                bool is_shared = source.locked(globals[i]);
+
+                if (is_shared) {
+                    auto it = shared.find(globals[i]);
+
+                    if (it != shared.end()) {
+                        index[v] = it->second;
+                        continue;
+                    }
+                }
+
+                auto const &components = chunk.m_vertices[v].components;
+                auto const &p = components.position;
+
+                fout << "v " << p.x << " " << p.y << " " << p.z;
+
+                if (source.has_color()) {
+                    fout << " " << components.color.r << " " << components.color.g << " " << components.color.b << " " << components.color.a;
+                }
+
+                fout << "\n";
+
+                index[v] = ++written;
+
+                if (is_shared) {
+                    shared[globals[i]] = index[v];
+                }
+            }
+
+            // one uv per face corner like Mesh::save_to_file, seams stay as they are
+            if (source.has_uv()) {
+                for (auto const &face : chunk.m_faces) {
+                    fout << "vt " << face.uv0.x << " " << face.uv0.y << "\n";
+                    fout << "vt " << face.uv1.x << " " << face.uv1.y << "\n";
+                    fout << "vt " << face.uv2.x << " " << face.uv2.y << "\n";
+                }
+            }
+
+            for (auto const &face : chunk.m_faces) {
+                fout << "f";
+
+                for (uint j = 0; j < 3; j++) {
+                    fout << " " << index[*(&face.v0 + j)];
+
+                    if (source.has_uv()) {
+                        fout << "/" << ++written_uvs;
+                    }
+                }
+
+                fout << "\n";
+            }
+
+            faces.clear();
+        }
+
+        return true;
+    }
+
+}
+
+
+#endif //MESHSIMPLIFICATION_STREAMSIMPLIFY_H
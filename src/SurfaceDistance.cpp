@@ -0,0 +1,294 @@
+#include "SurfaceDistance.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "../common/parallel.h"
+
+
+namespace Measure {
+
+    namespace {
+
+        uint64_t mix(uint64_t x) {
+            x += 0x9e3779b97f4a7c15ull;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+            return x ^ (x >> 31);
+        }
+
+        // Uniform in [0, 1) from a seed
+
+        double uniform(uint64_t seed) {
+            return static_cast<double>(mix(seed) >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        double box_distance(vec3f const &p, vec3f const &lo, vec3f const &hi) {
+            vec3f d = glm::max(glm::max(lo - p, p - hi), vec3f(0.f));
+            return glm::dot(d, d);
+        }
+
+        // Closest point of triangle abc to p, Ericson - Real-Time Collision Detection 5.1.5
+
+        vec3f closest_point(vec3f const &p, vec3f const &a, vec3f const &b, vec3f const &c) {
+            vec3f ab = b - a, ac = c - a, ap = p - a;
+
+            float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+            if (d1 <= 0 && d2 <= 0) return a;
+
+            vec3f bp = p - b;
+            float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+            if (d3 >= 0 && d4 <= d3) return b;
+
+            float vc = d1 * d4 - d3 * d2;
+            if (vc <= 0 && d1 >= 0 && d3 <= 0) return a + ab * (d1 / (d1 - d3));
+
+            vec3f cp = p - c;
+            float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+            if (d6 >= 0 && d5 <= d6) return c;
+
+            float vb = d5 * d2 - d1 * d6;
+            if (vb <= 0 && d2 >= 0 && d6 <= 0) return a + ac * (d2 / (d2 - d6));
+
+            float va = d3 * d6 - d5 * d4;
+            if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+            float denom = 1.f / (va + vb + vc);
+            return a + ab * (vb * denom) + ac * (vc * denom);
+        }
+
+        struct Accumulator {
+            double max = 0;
+            double sum = 0;
+            double sum_squares = 0;
+            unsigned int samples = 0;
+        };
+
+    }
+
+
+    BVH::BVH(Surface const &surface) : m_surface(&surface) {
+        int count = static_cast<int>(surface.faces.size());
+
+        std::vector<vec3f> centroids(count);
+
+        for (int i = 0; i < count; i++) {
+            glm::uvec3 const &f = surface.faces[i];
+            centroids[i] = (surface.positions[f.x] + surface.positions[f.y] + surface.positions[f.z]) / 3.f;
+        }
+
+        m_faces.resize(count);
+
+        for (int i = 0; i < count; i++) {
+            m_faces[i] = i;
+        }
+
+        m_nodes.reserve(2 * (count / leaf_size + 1));
+        m_nodes.push_back(Node());
+
+        build(0, 0, count, centroids);
+    }
+
+    void BVH::build(int node, int begin, int end, std::vector<vec3f> const &centroids) {
+        vec3f lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+        vec3f centroid_lo = lo, centroid_hi = hi;
+
+        for (int i = begin; i < end; i++) {
+            glm::uvec3 const &f = m_surface->faces[m_faces[i]];
+
+            for (int j = 0; j < 3; j++) {
+                lo = glm::min(lo, m_surface->positions[f[j]]);
+                hi = glm::max(hi, m_surface->positions[f[j]]);
+            }
+
+            centroid_lo = glm::min(centroid_lo, centroids[m_faces[i]]);
+            centroid_hi = glm::max(centroid_hi, centroids[m_faces[i]]);
+        }
+
+        m_nodes[node].lo = lo;
+        m_nodes[node].hi = hi;
+
+        if (end - begin <= leaf_size) {
+            m_nodes[node].first = begin;
+            m_nodes[node].count = end - begin;
+            return;
+        }
+
+        vec3f extent = centroid_hi - centroid_lo;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        int mid = begin + (end - begin) / 2;
+
+        std::nth_element(m_faces.begin() + begin, m_faces.begin() + mid, m_faces.begin() + end, [&centroids, axis](int a, int b) {
+            return centroids[a][axis] < centroids[b][axis];
+        });
+
+        int first = static_cast<int>(m_nodes.size());
+        m_nodes.push_back(Node());
+        m_nodes.push_back(Node());
+
+        m_nodes[node].first = first;
+        m_nodes[node].count = 0;
+
+        build(first, begin, mid, centroids);
+        build(first + 1, mid, end, centroids);
+    }
+
+    double BVH::face_distance(vec3f const &p, int face) const {
+        glm::uvec3 const &f = m_surface->faces[face];
+        vec3f d = p - closest_point(p, m_surface->positions[f.x], m_surface->positions[f.y], m_surface->positions[f.z]);
+
+        return glm::dot(d, d);
+    }
+
+    double BVH::closest(vec3f const &p, int &face) const {
+        double best = std::numeric_limits<double>::infinity();
+
+        if (m_faces.empty()) return best;
+
+        if (face >= 0) {
+            best = face_distance(p, face);
+        }
+
+        // median splits keep the depth below 32 for any face count that fits an int
+        int stack[64];
+        int size = 0;
+
+        stack[size++] = 0;
+
+        while (size > 0) {
+            Node const &node = m_nodes[stack[--size]];
+
+            if (box_distance(p, node.lo, node.hi) >= best) continue;
+
+            if (node.count > 0) {
+                for (int i = node.first; i < node.first + node.count; i++) {
+                    double d = face_distance(p, m_faces[i]);
+
+                    if (d < best) {
+                        best = d;
+                        face = m_faces[i];
+                    }
+                }
+
+                continue;
+            }
+
+            // visit the nearer child first, it is on top of the stack
+            int near = node.first, far = node.first + 1;
+
+            if (box_distance(p, m_nodes[far].lo, m_nodes[far].hi) < box_distance(p, m_nodes[near].lo, m_nodes[near].hi)) {
+                std::swap(near, far);
+            }
+
+            stack[size++] = far;
+            stack[size++] = near;
+        }
+
+        return best;
+    }
+
+    OneSided one_sided(Surface const &from, BVH const &to, Options const &options) {
+        unsigned int threads = thread_count(options.threads);
+        int face_count = static_cast<int>(from.faces.size());
+        int vertex_count = static_cast<int>(from.positions.size());
+
+        std::vector<double> areas(face_count);
+        double total_area = 0;
+
+        for (int i = 0; i < face_count; i++) {
+            glm::uvec3 const &f = from.faces[i];
+            vec3f const &a = from.positions[f.x];
+
+            areas[i] = 0.5 * glm::length(glm::cross(from.positions[f.y] - a, from.positions[f.z] - a));
+            total_area += areas[i];
+        }
+
+        double samples = options.samples != 0 ? options.samples : 10.0 * face_count;
+        double density = total_area > 0 ? samples / total_area : 0;
+
+        std::vector<Accumulator> accumulators(threads);
+
+        // area samples, the fraction of a sample is rounded up with its probability
+        parallel_for(threads, 0, face_count, [&](unsigned int thread, int begin, int end) {
+            Accumulator &acc = accumulators[thread];
+
+            // samples of neighbouring faces are close, start from the last closest face
+            int hint = -1;
+
+            for (int i = begin; i < end; i++) {
+                uint64_t seed = mix(static_cast<uint64_t>(i));
+                double expected = areas[i] * density;
+                auto count = static_cast<unsigned int>(expected + uniform(seed));
+
+                glm::uvec3 const &f = from.faces[i];
+                vec3f const &a = from.positions[f.x];
+                vec3f const &b = from.positions[f.y];
+                vec3f const &c = from.positions[f.z];
+
+                for (unsigned int k = 0; k < count; k++) {
+                    // uniform point in the triangle
+                    double r1 = std::sqrt(uniform(seed + 2 * k + 1));
+                    double r2 = uniform(seed + 2 * k + 2);
+
+                    vec3f p = a * static_cast<float>(1 - r1) + b * static_cast<float>(r1 * (1 - r2)) + c * static_cast<float>(r1 * r2);
+                    double d2 = to.closest(p, hint);
+                    double d = std::sqrt(d2);
+
+                    acc.max = std::max(acc.max, d);
+                    acc.sum += d;
+                    acc.sum_squares += d2;
+                    acc.samples++;
+                }
+            }
+        }, 256);
+
+        std::vector<double> vertex_max(threads, 0);
+
+        parallel_for(threads, 0, vertex_count, [&](unsigned int thread, int begin, int end) {
+            int hint = -1;
+
+            for (int i = begin; i < end; i++) {
+                vertex_max[thread] = std::max(vertex_max[thread], std::sqrt(to.closest(from.positions[i], hint)));
+            }
+        }, 256);
+
+        OneSided result;
+        double sum = 0, sum_squares = 0;
+
+        for (unsigned int t = 0; t < threads; t++) {
+            result.max = std::max(result.max, std::max(accumulators[t].max, vertex_max[t]));
+            result.samples += accumulators[t].samples;
+            sum += accumulators[t].sum;
+            sum_squares += accumulators[t].sum_squares;
+        }
+
+        if (result.samples != 0) {
+            result.mean = sum / result.samples;
+            result.rms = std::sqrt(sum_squares / result.samples);
+        }
+
+        return result;
+    }
+
+    Comparison compare(Surface const &a, Surface const &b, Options const &options) {
+        Comparison result;
+
+        {
+            BVH bvh(b);
+            result.forward = one_sided(a, bvh, options);
+        }
+
+        {
+            BVH bvh(a);
+            result.backward = one_sided(b, bvh, options);
+        }
+
+        result.hausdorff = std::max(result.forward.max, result.backward.max);
+        result.rms = std::max(result.forward.rms, result.backward.rms);
+
+        return result;
+    }
+
+}
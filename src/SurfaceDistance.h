@@ -0,0 +1,117 @@
+#ifndef MESHSIMPLIFICATION_SURFACEDISTANCE_H
+#define MESHSIMPLIFICATION_SURFACEDISTANCE_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Mesh.h"
+
+
+namespace Measure {
+
+    using vec3f = glm::vec3;
+
+    // Positions and triangles of a mesh, all that is needed to measure it
+
+    struct Surface {
+        std::vector<vec3f> positions;
+        std::vector<glm::uvec3> faces;
+    };
+
+    template <typename T, typename S>
+    Surface surface(Mesh<T, S> const &mesh) {
+        Surface s;
+        s.positions.reserve(mesh.vertex_count());
+        s.faces.reserve(mesh.faces().size());
+
+        for (uint i = 0; i < mesh.vertex_count(); i++) {
+            s.positions.push_back(mesh.position(i));
+        }
+
+        for (auto const &face : mesh.faces()) {
+            s.faces.emplace_back(face.v0, face.v1, face.v2);
+        }
+
+        return s;
+    }
+
+    //
+    // Bounding volume hierarchy over the faces of a surface, answers closest point
+    // queries. Built top down by splitting at the median centroid of the longest axis,
+    // leaves hold up to leaf_size faces. The surface must outlive the hierarchy.
+    //
+    class BVH {
+        struct Node {
+            vec3f lo, hi;
+            int first;  // first child (the second follows it) or first face of a leaf
+            int count;  // faces of a leaf, 0 for an inner node
+        };
+
+        static const int leaf_size = 4;
+
+        Surface const *m_surface = nullptr;
+        std::vector<Node> m_nodes;
+        std::vector<int> m_faces;
+
+    public:
+        explicit BVH(Surface const &surface);
+
+        //
+        // Squared distance from p to the closest point of the surface, infinity when it
+        // has no faces. face receives the closest face, when it holds one on input that
+        // face bounds the search from the start, which pays off for nearby queries.
+        //
+        double closest(vec3f const &p, int &face) const;
+
+        double closest(vec3f const &p) const {
+            int face = -1;
+            return closest(p, face);
+        }
+
+    private:
+        void build(int node, int begin, int end, std::vector<vec3f> const &centroids);
+
+        double face_distance(vec3f const &p, int face) const;
+    };
+
+    struct Options {
+        // worker threads, 0 means one per hardware thread
+        unsigned int threads = 0;
+        // points sampled on the area of a surface, 0 means 10 per face
+        unsigned int samples = 0;
+    };
+
+    // Distances from the points sampled on one surface to another
+
+    struct OneSided {
+        double max = 0;     // one-sided Hausdorff distance
+        double mean = 0;
+        double rms = 0;
+        unsigned int samples = 0;
+    };
+
+    struct Comparison {
+        OneSided forward;   // from the first surface to the second
+        OneSided backward;  // from the second surface to the first
+
+        // symmetric Hausdorff distance and RMS error, the larger of both sides
+        double hausdorff = 0;
+        double rms = 0;
+    };
+
+    //
+    // Sample points on from and measure their distance to the surface in to. Every
+    // vertex is a sample and the faces get samples in proportion to their area, placed
+    // by a hash of the face id so results don't depend on the thread count. Vertices
+    // only count for the maximum, mean and RMS are over the area samples.
+    //
+    OneSided one_sided(Surface const &from, BVH const &to, Options const &options = Options());
+
+    // Metro style comparison of two surfaces, e.g. an original and a simplified one
+
+    Comparison compare(Surface const &a, Surface const &b, Options const &options = Options());
+
+}
+
+
+#endif //MESHSIMPLIFICATION_SURFACEDISTANCE_H
@@ -0,0 +1,172 @@
+#ifndef MESHSIMPLIFICATION_SYMETRICMATRIX_H
+#define MESHSIMPLIFICATION_SYMETRICMATRIX_H
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SYMETRIC_MATRIX_AVX
+#define SYMETRIC_MATRIX_SSE2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SYMETRIC_MATRIX_SSE2
+#endif
+
+
+//
+// Precision policies of the quadrics: the type the coefficients are stored in and
+// the type sums, errors and solutions are computed in. Float halves the memory of
+// the quadrics and doubles the SIMD width, Mixed keeps the memory of Float and
+// accumulates in double.
+//
+namespace Precision {
+
+    template <typename TStorage, typename TCompute = TStorage>
+    struct Policy {
+        using storage = TStorage;
+        using compute = TCompute;
+    };
+
+    using Double = Policy<double>;
+    using Float = Policy<float>;
+    using Mixed = Policy<float, double>;
+
+}
+
+
+//
+// Quadric of the error metric, the upper triangle of a symmetric 4x4 matrix.
+// SYMETRIC_MATRIX_AVX / SYMETRIC_MATRIX_SSE2 tell the batched kernels in
+// Simplify.cpp which vector width the compiler targets.
+//
+template <typename TPrecision>
+class SymetricMatrixT {
+
+public:
+
+    using storage = typename TPrecision::storage;
+    using compute = typename TPrecision::compute;
+
+    // sum of two quadrics, kept in the compute precision
+    using Sum = SymetricMatrixT<Precision::Policy<compute>>;
+
+    // Constructor
+
+    SymetricMatrixT(compute c=0) {
+        for (int i = 0; i < 10; i++) {
+            m[i] = static_cast<storage>(c);
+        }
+    }
+
+    SymetricMatrixT(	compute m11, compute m12, compute m13, compute m14,
+                       compute m22, compute m23, compute m24,
+                       compute m33, compute m34,
+                       compute m44) {
+        m[0] = m11;  m[1] = m12;  m[2] = m13;  m[3] = m14;
+        m[4] = m22;  m[5] = m23;  m[6] = m24;
+        m[7] = m33;  m[8] = m34;
+        m[9] = m44;
+    }
+
+    // Make plane
+
+    SymetricMatrixT(compute a,compute b,compute c,compute d)
+    {
+        m[0] = a*a;  m[1] = a*b;  m[2] = a*c;  m[3] = a*d;
+        m[4] = b*b;  m[5] = b*c;  m[6] = b*d;
+        m[7 ] =c*c;  m[8 ] = c*d;
+        m[9 ] = d*d;
+    }
+
+    // Same quadric in another precision, rounded to the storage type
+
+    template <typename TOther>
+    explicit SymetricMatrixT(SymetricMatrixT<TOther> const &q) {
+        for (int i = 0; i < 10; i++) {
+            m[i] = static_cast<storage>(q.m[i]);
+        }
+    }
+
+    compute operator[](int c) const { return m[c]; }
+
+    // Determinant
+
+    compute det(	int a11, int a12, int a13,
+                   int a21, int a22, int a23,
+                   int a31, int a32, int a33) const
+    {
+        compute det =  (*this)[a11]*(*this)[a22]*(*this)[a33] + (*this)[a13]*(*this)[a21]*(*this)[a32] + (*this)[a12]*(*this)[a23]*(*this)[a31]
+                       - (*this)[a13]*(*this)[a22]*(*this)[a31] - (*this)[a11]*(*this)[a23]*(*this)[a32]- (*this)[a12]*(*this)[a21]*(*this)[a33];
+        return det;
+    }
+
+    //
+    // Position with the minimal error: solves the upper left 3x3 block against
+    // the negated last column with the cofactors of the block, which is symmetric.
+    // Returns the determinant of the block, x, y and z are only set when it is not 0.
+    //
+    compute solve(double &x, double &y, double &z) const
+    {
+        compute q[10];
+
+        for (int i = 0; i < 10; i++) {
+            q[i] = m[i];
+        }
+
+        compute c[6] = {
+                q[4]*q[7] - q[5]*q[5],
+                q[2]*q[5] - q[1]*q[7],
+                q[1]*q[5] - q[2]*q[4],
+                q[0]*q[7] - q[2]*q[2],
+                q[1]*q[2] - q[0]*q[5],
+                q[0]*q[4] - q[1]*q[1]
+        };
+        compute det = q[0]*c[0] + q[1]*c[1] + q[2]*c[2];
+
+        if (det != 0) {
+            compute inv = -1 / det;
+
+            x = inv * (c[0]*q[3] + c[1]*q[6] + c[2]*q[8]);
+            y = inv * (c[1]*q[3] + c[3]*q[6] + c[4]*q[8]);
+            z = inv * (c[2]*q[3] + c[4]*q[6] + c[5]*q[8]);
+        }
+
+        return det;
+    }
+
+    const Sum operator+(const SymetricMatrixT& n) const
+    {
+        Sum r(*this);
+        r += n;
+        return r;
+    }
+
+    template <typename TOther>
+    SymetricMatrixT& operator+=(const SymetricMatrixT<TOther>& n)
+    {
+        // Plain loop over the packed storage, compiles to packed adds on SSE2 and AVX
+        for (int i = 0; i < 10; i++) {
+            m[i] = static_cast<storage>(static_cast<compute>(m[i]) + static_cast<compute>(n.m[i]));
+        }
+        return *this;
+    }
+
+    storage m[10];
+};
+
+
+//
+// Precision of the simplifier, chosen at compile time with SYMETRIC_MATRIX_FLOAT or
+// SYMETRIC_MATRIX_MIXED (CMake option MESHSIMPLIFICATION_QUADRIC_PRECISION), double
+// when neither is set.
+//
+#if defined(SYMETRIC_MATRIX_FLOAT)
+using QuadricPrecision = Precision::Float;
+#elif defined(SYMETRIC_MATRIX_MIXED)
+using QuadricPrecision = Precision::Mixed;
+#else
+using QuadricPrecision = Precision::Double;
+#endif
+
+using SymetricMatrix = SymetricMatrixT<QuadricPrecision>;
+
+
+#endif //MESHSIMPLIFICATION_SYMETRICMATRIX_H
@@ -0,0 +1,536 @@
+//
+// Headless simplification benchmark, needs no GL. Runs the engine on model files and on
+// synthetic subdivided spheres over several methods, ratios and thread counts and writes
+// throughput, peak memory, quality and the simplifier stats of every run as JSON.
+//
+//   MeshSimplificationBenchmark [--models a.obj,b.off] [--sizes 10000,100000,...]
+//                               [--ratios 0.5,0.1] [--threads 1,0] [--methods threshold,heap]
+//                               [--schedule fixed|adaptive] [--samples 1000000] [--output benchmark.json]
+//                               [--help]
+//
+// Thread count 0 means one per hardware thread, --models and --sizes may be empty ("").
+// The engine logs to stdout, so the JSON goes to a file.
+//
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "Mesh.h"
+#include "SurfaceDistance.h"
+#include "../common/parallel.h"
+
+
+namespace {
+
+    using BenchMesh = Mesh<VertexComponentsColored>;
+    using BenchVertex = Vertex<VertexComponentsColored>;
+
+    struct Options {
+        std::vector<std::string> models = {"robot.obj", "model.off"};
+        std::vector<int> sizes = {10000, 100000, 1000000, 10000000};
+        std::vector<float> ratios = {0.5f, 0.1f, 0.01f};
+        std::vector<unsigned int> threads = {1, 0};
+        std::vector<Simplify::Method> methods = {Simplify::Method::Threshold};
+        Simplify::Schedule schedule = Simplify::Schedule::Fixed;
+        unsigned int samples = 1000000;
+        std::string output = "benchmark.json";
+        bool help = false;
+    };
+
+    void print_usage(FILE *out) {
+        fprintf(out,
+                "usage: MeshSimplificationBenchmark [--models a.obj,b.off] [--sizes 10000,100000,...]\n"
+                "                                   [--ratios 0.5,0.1] [--threads 1,0] [--methods threshold,heap]\n"
+                "                                   [--schedule fixed|adaptive] [--samples 1000000] [--output benchmark.json]\n"
+                "                                   [--help]\n"
+                "methods: threshold, heap, partitioned, clustering, parallel. Thread count 0 means one per\n"
+                "hardware thread, --models and --sizes may be empty (\"\").\n");
+    }
+
+    struct Input {
+        std::string name;
+        BenchMesh mesh;
+    };
+
+    std::vector<std::string> split(std::string const &list) {
+        std::vector<std::string> items;
+        std::stringstream stream(list);
+        std::string item;
+
+        while (std::getline(stream, item, ',')) {
+            if (!item.empty()) items.push_back(item);
+        }
+
+        return items;
+    }
+
+    char const *method_name(Simplify::Method method) {
+        switch (method) {
+            case Simplify::Method::Threshold: return "threshold";
+            case Simplify::Method::Heap: return "heap";
+            case Simplify::Method::Partitioned: return "partitioned";
+            case Simplify::Method::Clustering: return "clustering";
+            case Simplify::Method::Parallel: return "parallel";
+        }
+
+        return "unknown";
+    }
+
+    bool parse_method(std::string const &name, Simplify::Method &method) {
+        for (auto m : {Simplify::Method::Threshold, Simplify::Method::Heap, Simplify::Method::Partitioned, Simplify::Method::Clustering,
+                       Simplify::Method::Parallel}) {
+            if (name == method_name(m)) {
+                method = m;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool is_option(std::string const &flag) {
+        for (char const *option : {"--models", "--sizes", "--ratios", "--threads", "--methods", "--schedule", "--samples", "--output"}) {
+            if (flag == option) return true;
+        }
+
+        return false;
+    }
+
+    // One option with its value, may throw on a malformed number
+
+    bool parse_option(std::string const &flag, std::string const &value, Options &options) {
+        if (flag == "--models") {
+            options.models = split(value);
+        }
+        else if (flag == "--sizes") {
+            options.sizes.clear();
+            for (auto const &s : split(value)) options.sizes.push_back(std::stoi(s));
+        }
+        else if (flag == "--ratios") {
+            options.ratios.clear();
+            for (auto const &s : split(value)) options.ratios.push_back(std::stof(s));
+        }
+        else if (flag == "--threads") {
+            options.threads.clear();
+            for (auto const &s : split(value)) options.threads.push_back(static_cast<unsigned int>(std::stoul(s)));
+        }
+        else if (flag == "--methods") {
+            options.methods.clear();
+
+            for (auto const &s : split(value)) {
+                Simplify::Method method;
+
+                if (!parse_method(s, method)) {
+                    fprintf(stderr, "unknown method %s\n", s.c_str());
+                    return false;
+                }
+
+                options.methods.push_back(method);
+            }
+        }
+        else if (flag == "--schedule") {
+            if (value != "fixed" && value != "adaptive") {
+                fprintf(stderr, "unknown schedule %s\n", value.c_str());
+                return false;
+            }
+
+            options.schedule = value == "adaptive" ? Simplify::Schedule::Adaptive : Simplify::Schedule::Fixed;
+        }
+        else if (flag == "--samples") {
+            options.samples = static_cast<unsigned int>(std::stoul(value));
+        }
+        else if (flag == "--output") {
+            options.output = value;
+        }
+
+        return true;
+    }
+
+    // False with a message on stderr for unknown options, missing or malformed values
+
+    bool parse_options(int argc, char **argv, Options &options) {
+        for (int i = 1; i < argc; i += 2) {
+            std::string flag = argv[i];
+
+            if (flag == "--help" || flag == "-h") {
+                options.help = true;
+                return true;
+            }
+
+            if (!is_option(flag)) {
+                fprintf(stderr, "unknown option %s\n", flag.c_str());
+                return false;
+            }
+
+            if (i + 1 == argc) {
+                fprintf(stderr, "option %s needs a value\n", flag.c_str());
+                return false;
+            }
+
+            std::string value = argv[i + 1];
+
+            try {
+                if (!parse_option(flag, value, options)) return false;
+            }
+            catch (std::exception const &) {
+                // std::stoi and friends on a value that isn't a number
+                fprintf(stderr, "bad value %s for %s\n", value.c_str(), flag.c_str());
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Polygons of an OFF file as triangle fans, colours after the indices are ignored
+
+    bool load_off(std::string const &fileName, BenchMesh &mesh) {
+        std::ifstream fin(fileName);
+        std::string line;
+        std::vector<long> header;
+
+        std::vector<BenchVertex> vertices;
+        std::vector<Face> faces;
+        long vertex_count = -1, face_count = -1;
+
+        while (std::getline(fin, line)) {
+            auto comment = line.find('#');
+            if (comment != std::string::npos) line.erase(comment);
+
+            std::stringstream stream(line);
+
+            if (vertex_count < 0) {
+                std::string word;
+
+                while (stream >> word) {
+                    if (word == "OFF") continue;
+                    header.push_back(std::stol(word));
+                }
+
+                if (header.size() >= 2) {
+                    vertex_count = header[0];
+                    face_count = header[1];
+                }
+            }
+            else if (vertices.size() < vertex_count) {
+                BenchVertex vertex{};
+                glm::vec3 &p = vertex.components.position;
+
+                if (!(stream >> p.x >> p.y >> p.z)) continue;
+
+                vertex.components.color = glm::vec4(1.f);
+                vertices.push_back(vertex);
+            }
+            else if (face_count-- > 0) {
+                int n;
+                std::vector<uint> polygon;
+
+                if (!(stream >> n)) { face_count++; continue; }
+
+                for (int k = 0; k < n; k++) {
+                    uint v;
+                    stream >> v;
+                    polygon.push_back(v);
+                }
+
+                for (int k = 1; k + 1 < n; k++) {
+                    Face face{};
+                    face.v0 = polygon[0];
+                    face.v1 = polygon[k];
+                    face.v2 = polygon[k + 1];
+                    faces.push_back(face);
+                }
+            }
+        }
+
+        if (vertices.empty() || faces.empty()) return false;
+
+        mesh.assign(std::move(vertices), std::move(faces));
+        return true;
+    }
+
+    bool load(std::string const &fileName, BenchMesh &mesh) {
+        std::string extension = fileName.size() >= 4 ? fileName.substr(fileName.size() - 4) : "";
+
+        if (extension == ".off" || extension == ".OFF") {
+            return load_off(fileName, mesh);
+        }
+
+        if (!std::ifstream(fileName).good()) return false;
+
+        mesh.load_from_file(fileName);
+        return !mesh.faces().empty();
+    }
+
+    //
+    // Octahedron with n segments per edge projected to a sphere with a few bumps, 8 n^2
+    // faces. Lattice points with |a| + |b| + |c| = n are the vertices, shared between octants.
+    //
+    BenchMesh subdivided_sphere(int face_count) {
+        int n = glm::max(1, static_cast<int>(std::lround(std::sqrt(face_count / 8.0))));
+        long long side = 2 * n + 1;
+
+        std::unordered_map<long long, uint> index;
+        std::vector<BenchVertex> vertices;
+        std::vector<Face> faces;
+        faces.reserve(8ll * n * n);
+
+        auto vertex = [&](int a, int b, int c) {
+            long long key = ((a + n) * side + (b + n)) * side + (c + n);
+            auto it = index.find(key);
+
+            if (it != index.end()) return it->second;
+
+            glm::vec3 d = glm::normalize(glm::vec3(a, b, c));
+            float r = 1.f + 0.05f * std::sin(7.f * d.x) * std::sin(5.f * d.y) * std::sin(3.f * d.z);
+
+            BenchVertex v{};
+            v.components.position = d * r;
+            v.components.normal = d;
+            v.components.color = glm::vec4(1.f);
+
+            uint id = static_cast<uint>(vertices.size());
+            vertices.push_back(v);
+            index.emplace(key, id);
+
+            return id;
+        };
+
+        auto triangle = [&](uint v0, uint v1, uint v2) {
+            glm::vec3 const &p0 = vertices[v0].components.position;
+            glm::vec3 const &p1 = vertices[v1].components.position;
+            glm::vec3 const &p2 = vertices[v2].components.position;
+
+            Face face{};
+            face.v0 = v0;
+
+            // outward facing
+            if (glm::dot(glm::cross(p1 - p0, p2 - p0), p0 + p1 + p2) >= 0) {
+                face.v1 = v1; face.v2 = v2;
+            }
+            else {
+                face.v1 = v2; face.v2 = v1;
+            }
+
+            faces.push_back(face);
+        };
+
+        for (int octant = 0; octant < 8; octant++) {
+            int sx = octant & 1 ? -1 : 1, sy = octant & 2 ? -1 : 1, sz = octant & 4 ? -1 : 1;
+
+            // row i has the points (n - i, i - j, j)
+            auto point = [&](int i, int j) {
+                return vertex(sx * (n - i), sy * (i - j), sz * j);
+            };
+
+            for (int i = 0; i < n; i++) {
+                for (int j = 0; j <= i; j++) {
+                    triangle(point(i, j), point(i + 1, j), point(i + 1, j + 1));
+
+                    if (j < i) triangle(point(i, j), point(i + 1, j + 1), point(i, j + 1));
+                }
+            }
+        }
+
+        BenchMesh mesh;
+        mesh.assign(std::move(vertices), std::move(faces));
+
+        return mesh;
+    }
+
+    // Resident set size peak, reset in between where the OS allows it (Linux)
+
+    void reset_peak_rss() {
+#if defined(__linux__)
+        std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+    }
+
+    size_t peak_rss() {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+        return counters.PeakWorkingSetSize;
+#else
+#if defined(__linux__)
+        std::ifstream status("/proc/self/status");
+        std::string line;
+
+        while (std::getline(status, line)) {
+            if (line.compare(0, 6, "VmHWM:") == 0) {
+                return std::stoull(line.substr(6)) * 1024;
+            }
+        }
+#endif
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+        return static_cast<size_t>(usage.ru_maxrss);
+#else
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+    }
+
+    std::string escape(std::string const &s) {
+        std::string r;
+
+        for (char c : s) {
+            if (c == '"' || c == '\\') r += '\\';
+            r += c;
+        }
+
+        return r;
+    }
+
+    double diagonal(BenchMesh const &mesh) {
+        glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+
+        for (auto const &vertex : mesh.vertices()) {
+            lo = glm::min(lo, vertex.components.position);
+            hi = glm::max(hi, vertex.components.position);
+        }
+
+        return mesh.vertices().empty() ? 0 : glm::length(hi - lo);
+    }
+
+}
+
+
+int main(int argc, char **argv) {
+    Options options;
+
+    if (!parse_options(argc, argv, options)) {
+        print_usage(stderr);
+        return 1;
+    }
+
+    if (options.help) {
+        print_usage(stdout);
+        return 0;
+    }
+
+    std::ofstream json(options.output);
+
+    if (!json.is_open()) {
+        fprintf(stderr, "can't write %s\n", options.output.c_str());
+        return 1;
+    }
+
+    std::vector<Input> inputs;
+
+    for (auto const &model : options.models) {
+        Input input;
+        input.name = model;
+
+        if (!load(model, input.mesh)) {
+            fprintf(stderr, "can't read %s, skipped\n", model.c_str());
+            continue;
+        }
+
+        inputs.push_back(std::move(input));
+    }
+
+    for (int size : options.sizes) {
+        inputs.push_back(Input{"sphere_" + std::to_string(size), subdivided_sphere(size)});
+    }
+
+    json << "{\n  \"hardware_threads\": " << thread_count() << ",\n  \"runs\": [";
+
+    bool first = true;
+
+    for (auto const &input : inputs) {
+        Measure::Surface original = Measure::surface(input.mesh);
+        double size = diagonal(input.mesh);
+        uint face_count = static_cast<uint>(input.mesh.faces().size());
+
+        for (auto method : options.methods) {
+            for (float ratio : options.ratios) {
+                for (unsigned int threads : options.threads) {
+                    uint target = static_cast<uint>(ratio * face_count);
+
+                    BenchMesh mesh = input.mesh;
+                    mesh.set_simplify_method(method);
+                    mesh.set_threads(threads);
+                    mesh.set_threshold_schedule(options.schedule);
+
+                    reset_peak_rss();
+
+                    auto start = std::chrono::steady_clock::now();
+                    mesh.simplify(target);
+                    auto end = std::chrono::steady_clock::now();
+
+                    size_t rss = peak_rss();
+                    double seconds = std::chrono::duration<double>(end - start).count();
+                    uint faces = static_cast<uint>(mesh.faces().size());
+                    double throughput = seconds > 0 ? (face_count - faces) / seconds : 0;
+
+                    Measure::Options measure;
+                    measure.threads = threads;
+                    measure.samples = options.samples;
+
+                    Measure::Comparison distance = Measure::compare(original, Measure::surface(mesh), measure);
+                    Simplify::Stats const &stats = mesh.stats();
+
+                    fprintf(stderr, "%s %s ratio %g threads %u - %u -> %u faces in %.3f s, %.0f faces/s, hausdorff %g\n",
+                            input.name.c_str(), method_name(method), ratio, thread_count(threads), face_count, faces,
+                            seconds, throughput, distance.hausdorff);
+
+                    json << (first ? "\n" : ",\n") << "    {"
+                         << "\"input\": \"" << escape(input.name) << "\", "
+                         << "\"method\": \"" << method_name(method) << "\", "
+                         << "\"schedule\": \"" << (options.schedule == Simplify::Schedule::Adaptive ? "adaptive" : "fixed") << "\", "
+                         << "\"ratio\": " << ratio << ", "
+                         << "\"threads\": " << thread_count(threads) << ", "
+                         << "\"vertices\": " << input.mesh.vertices().size() << ", "
+                         << "\"faces\": " << face_count << ", "
+                         << "\"target_faces\": " << target << ", "
+                         << "\"result_faces\": " << faces << ", "
+                         << "\"seconds\": " << seconds << ", "
+                         << "\"faces_removed_per_second\": " << throughput << ", "
+                         << "\"peak_rss_bytes\": " << rss << ", "
+                         << "\"diagonal\": " << size << ", "
+                         << "\"hausdorff\": " << distance.hausdorff << ", "
+                         << "\"rms\": " << distance.rms << ", "
+                         << "\"stats\": {"
+                         << "\"init_time\": " << stats.init_time << ", "
+                         << "\"border_time\": " << stats.border_time << ", "
+                         << "\"adjacency_time\": " << stats.adjacency_time << ", "
+                         << "\"collapse_time\": " << stats.collapse_time << ", "
+                         << "\"compact_time\": " << stats.compact_time << ", "
+                         << "\"iterations\": " << stats.iterations << ", "
+                         << "\"attempted\": " << stats.attempted << ", "
+                         << "\"collapses\": " << stats.collapses << ", "
+                         << "\"rejected_flip\": " << stats.rejected_flip << ", "
+                         << "\"rejected_border\": " << stats.rejected_border << ", "
+                         << "\"rejected_locked\": " << stats.rejected_locked << ", "
+                         << "\"rejected_target\": " << stats.rejected_target << ", "
+                         << "\"rejected_dirty\": " << stats.rejected_dirty << ", "
+                         << "\"rejected_overlap\": " << stats.rejected_overlap << ", "
+                         << "\"max_collapse_error\": " << stats.max_collapse_error << "}}";
+
+                    first = false;
+                }
+            }
+        }
+    }
+
+    json << "\n  ]\n}\n";
+
+    return 0;
+}
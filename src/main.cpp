@@ -1,9 +1,74 @@
 #include "Application.h"
+#include "StreamSimplify.h"
+#include "SurfaceDistance.h"
 
 
 int main(int argc, char **argv) {
+    // headless out-of-core simplification: --stream <input.obj> <output.obj> <ratio> [chunk faces]
+    if (argc >= 5 && std::string(argv[1]) == "--stream") {
+        Simplify::StreamOptions options;
+
+        if (argc >= 6) {
+            options.chunk_faces = std::stoi(argv[5]);
+        }
+
+        bool done = Simplify::simplify_file<VertexComponentsColored>(argv[2], argv[3], std::stof(argv[4]), options);
+
+        return done ? 0 : 1;
+    }
+
+    // LOD chain from one run: --lods <input.obj> <output prefix> <ratio>... writes <prefix><level>.obj
+    if (argc >= 5 && std::string(argv[1]) == "--lods") {
+        Mesh<VertexComponentsColored> mesh;
+        mesh.load_from_file(argv[2]);
+
+        std::vector<float> ratios;
+
+        for (int i = 4; i < argc; i++) {
+            float ratio = std::stof(argv[i]);
+
+            // every level goes on from the one before, so the ratios can only go down
+            if (ratio <= 0 || ratio > 1 || (!ratios.empty() && ratio > ratios.back())) {
+                std::cerr << "usage: --lods <input.obj> <output prefix> <ratio>..., ratios in (0, 1] in descending order" << std::endl;
+                return 1;
+            }
+
+            ratios.push_back(ratio);
+        }
+
+        auto levels = mesh.simplify_chain(ratios);
+
+        for (int i = 0; i < levels.size(); i++) {
+            std::string fileName = argv[3] + std::to_string(i) + ".obj";
+
+            if (!levels[i].save_to_file(fileName)) {
+                std::cerr << "can't write " << fileName << std::endl;
+                return 1;
+            }
+
+            printf("%s - %u triangles\n", fileName.c_str(), static_cast<uint>(levels[i].faces().size()));
+        }
+
+        return 0;
+    }
+
+    // compare two surfaces: --measure <original.obj> <simplified.obj>
+    if (argc >= 4 && std::string(argv[1]) == "--measure") {
+        Mesh<VertexComponentsColored> original, simplified;
+        original.load_from_file(argv[2]);
+        simplified.load_from_file(argv[3]);
+
+        Measure::Comparison distance = Measure::compare(Measure::surface(original), Measure::surface(simplified));
+
+        printf("forward - max %g, mean %g, rms %g, %u samples\n", distance.forward.max, distance.forward.mean, distance.forward.rms, distance.forward.samples);
+        printf("backward - max %g, mean %g, rms %g, %u samples\n", distance.backward.max, distance.backward.mean, distance.backward.rms, distance.backward.samples);
+        printf("hausdorff %g, rms %g\n", distance.hausdorff, distance.rms);
+
+        return 0;
+    }
+
     Application app;
     app.run();
 
     return 0;
-}
\ No newline at end of file
+}
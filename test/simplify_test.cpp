@@ -0,0 +1,305 @@
+//
+// Checks of the simplifier on small generated meshes, needs no GL or model files.
+// Failed checks are printed to stderr, the exit code is their number.
+//
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+#include "ProgressiveMesh.h"
+
+
+namespace {
+
+    using TestMesh = Mesh<VertexComponentsColored>;
+    using TestVertex = Vertex<VertexComponentsColored>;
+
+    int failures = 0;
+
+    void check(bool condition, std::string const &what) {
+        if (!condition) {
+            fprintf(stderr, "FAILED %s\n", what.c_str());
+            failures++;
+        }
+    }
+
+    //
+    // Closed sphere of rings latitude bands and segments longitude steps with a few bumps,
+    // 2 segments (rings - 1) faces
+    //
+    TestMesh uv_sphere(int rings, int segments) {
+        const float pi = 3.14159265f;
+
+        std::vector<TestVertex> vertices;
+        std::vector<Face> faces;
+
+        auto vertex = [&](glm::vec3 d) {
+            float r = 1.f + 0.05f * std::sin(7.f * d.x) * std::sin(5.f * d.y) * std::sin(3.f * d.z);
+
+            TestVertex v{};
+            v.components.position = d * r;
+            v.components.normal = d;
+            v.components.color = glm::vec4(1.f);
+            vertices.push_back(v);
+        };
+
+        auto face = [&](uint v0, uint v1, uint v2) {
+            Face f{};
+            f.v0 = v0; f.v1 = v1; f.v2 = v2;
+            faces.push_back(f);
+        };
+
+        vertex(glm::vec3(0.f, 0.f, 1.f));
+
+        for (int i = 1; i < rings; i++) {
+            float theta = pi * i / rings;
+
+            for (int j = 0; j < segments; j++) {
+                float phi = 2 * pi * j / segments;
+                vertex(glm::vec3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta)));
+            }
+        }
+
+        vertex(glm::vec3(0.f, 0.f, -1.f));
+
+        // first vertex of ring i (1 based) and the pole at the end
+        auto at = [&](int i, int j) { return static_cast<uint>(1 + (i - 1) * segments + (j % segments)); };
+        uint south = static_cast<uint>(vertices.size() - 1);
+
+        for (int j = 0; j < segments; j++) {
+            face(0, at(1, j), at(1, j + 1));
+            face(south, at(rings - 1, j + 1), at(rings - 1, j));
+
+            for (int i = 1; i + 1 < rings; i++) {
+                face(at(i, j), at(i + 1, j), at(i + 1, j + 1));
+                face(at(i, j), at(i + 1, j + 1), at(i, j + 1));
+            }
+        }
+
+        TestMesh mesh;
+        mesh.assign(std::move(vertices), std::move(faces));
+
+        return mesh;
+    }
+
+    // faces on the same three vertices in either winding
+
+    int coincident_faces(TestMesh const &mesh) {
+        std::set<std::array<uint, 3>> seen;
+        int copies = 0;
+
+        for (auto const &face : mesh.faces()) {
+            std::array<uint, 3> corners = {face.v0, face.v1, face.v2};
+            std::sort(corners.begin(), corners.end());
+
+            if (!seen.insert(corners).second) copies++;
+        }
+
+        return copies;
+    }
+
+    // clustering never empties a mesh for a target above 0, even when no cell size hits it,
+    // and leaves no coincident faces
+
+    void clustering_keeps_faces() {
+        TestMesh sphere = uv_sphere(5, 8);
+        int face_count = static_cast<int>(sphere.faces().size());
+
+        for (int target = 1; target < face_count; target++) {
+            TestMesh mesh = sphere;
+            mesh.set_simplify_method(Simplify::Method::Clustering);
+            mesh.simplify(static_cast<uint>(target));
+
+            int faces = static_cast<int>(mesh.faces().size());
+            check(faces > 0, "clustering to " + std::to_string(target) + " of " + std::to_string(face_count) + " faces left none");
+            check(coincident_faces(mesh) == 0, "clustering to " + std::to_string(target) + " of " + std::to_string(face_count) + " left coincident faces");
+        }
+    }
+
+    // an error bounded run collapses no edge above the bound, the cells of a partitioned run neither
+
+    void error_bound_holds() {
+        const double max_error = 0.005;
+
+        TestMesh sphere = uv_sphere(64, 160);
+        int face_count = static_cast<int>(sphere.faces().size());
+
+        for (auto method : {Simplify::Method::Threshold, Simplify::Method::Heap, Simplify::Method::Partitioned, Simplify::Method::Parallel}) {
+            std::string name = "method " + std::to_string(static_cast<int>(method));
+
+            TestMesh mesh = sphere;
+            mesh.set_simplify_method(method);
+            mesh.set_threads(4);
+
+            int faces = static_cast<int>(mesh.simplify_to_error(max_error, Simplify::ErrorBound::Distance));
+            Simplify::Stats const &stats = mesh.stats();
+
+            check(faces < face_count && stats.collapses > 0, name + " collapsed nothing");
+            check(stats.max_collapse_error <= max_error * max_error,
+                  name + " collapsed an edge with error " + std::to_string(stats.max_collapse_error) + " above " + std::to_string(max_error * max_error));
+        }
+    }
+
+    // corner positions of every face, starting at the smallest corner so the winding is kept
+
+    std::vector<std::array<float, 9>> face_positions(TestMesh const &mesh) {
+        std::vector<std::array<float, 9>> positions;
+
+        for (auto const &face : mesh.faces()) {
+            std::array<std::array<float, 3>, 3> corners;
+
+            for (uint j = 0; j < 3; j++) {
+                glm::vec3 const &p = mesh.position(*(&face.v0 + j));
+                corners[j] = {p.x, p.y, p.z};
+            }
+
+            std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+
+            std::array<float, 9> flat;
+            for (uint j = 0; j < 9; j++) flat[j] = corners[j / 3][j % 3];
+            positions.push_back(flat);
+        }
+
+        std::sort(positions.begin(), positions.end());
+
+        return positions;
+    }
+
+    bool same_bytes(TestMesh const &a, TestMesh const &b) {
+        return a.vertices().size() == b.vertices().size() && a.faces().size() == b.faces().size()
+               && std::memcmp(a.vertices().data(), b.vertices().data(), a.vertices().size() * sizeof(TestVertex)) == 0
+               && std::memcmp(a.faces().data(), b.faces().data(), a.faces().size() * sizeof(Face)) == 0;
+    }
+
+    // a recorded sequence holds the input faces and comes back to them exactly from any level
+
+    void progressive_round_trip() {
+        TestMesh sphere = uv_sphere(16, 32);
+        TestMesh input = sphere;
+
+        ProgressiveMesh<VertexComponentsColored> progressive;
+        progressive.record(sphere);
+
+        check(same_bytes(sphere, input), "recording changed the mesh");
+        check(progressive.levels() > 0 && progressive.max_face_count() == input.faces().size(), "recording kept no collapses");
+
+        TestMesh full;
+        progressive.extract(full);
+
+        check(face_positions(full) == face_positions(input), "the full level differs from the recorded mesh");
+
+        uint max_faces = progressive.max_face_count();
+
+        for (uint faces : {max_faces / 2, max_faces / 10, 0u, max_faces / 3}) {
+            progressive.set_face_count(faces);
+
+            TestMesh level;
+            progressive.extract(level);
+
+            check(level.faces().size() == progressive.face_count(), "extract wrote another level than the one set");
+            check(faces < progressive.min_face_count() || progressive.face_count() <= faces,
+                  "level of " + std::to_string(progressive.face_count()) + " faces for " + std::to_string(faces));
+        }
+
+        progressive.set_face_count(max_faces);
+        check(progressive.level() == 0, "the full face count is not level 0");
+
+        TestMesh back;
+        progressive.extract(back);
+
+        check(same_bytes(back, full), "the full level differs after going down and back");
+    }
+
+    // the parallel method collapses the same edges for any thread count, and a chain the same as separate runs
+
+    void parallel_is_deterministic() {
+        TestMesh sphere = uv_sphere(64, 160);
+        sphere.set_simplify_method(Simplify::Method::Parallel);
+
+        const float ratio = 0.2f;
+
+        TestMesh reference = sphere;
+        reference.set_threads(1);
+        reference.simplify(ratio);
+
+        for (unsigned int threads : {1u, 2u, 3u, 8u, 8u}) {
+            TestMesh mesh = sphere;
+            mesh.set_threads(threads);
+            mesh.simplify(ratio);
+
+            check(same_bytes(mesh, reference), "parallel run on " + std::to_string(threads) + " threads differs from 1 thread");
+        }
+
+        TestMesh half = sphere;
+        half.set_threads(1);
+        half.simplify(0.5f);
+
+        // the level copies number their vertices apart from a compacted mesh, their faces are the same
+        TestMesh chain = sphere;
+        chain.set_threads(4);
+        auto levels = chain.simplify_chain({0.5f, ratio});
+
+        check(same_bytes(chain, reference), "parallel chain ends apart from a single run");
+        check(levels.size() == 2 && face_positions(levels[0]) == face_positions(half) && face_positions(levels[1]) == face_positions(reference),
+              "levels of a parallel chain differ from single runs");
+    }
+
+    // the batched quadric errors equal the scalar ones bit for bit, whatever the lane width
+
+    void batched_errors_match() {
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> value(-2.f, 2.f);
+
+        int mismatches = 0;
+
+        for (int run = 0; run < 200; run++) {
+            SymetricMatrix::Sum q;
+
+            for (int k = 0; k < 3; k++) {
+                glm::vec3 n = glm::normalize(glm::vec3(value(random), value(random), value(random)));
+                q += SymetricMatrix::Sum(n.x, n.y, n.z, value(random));
+            }
+
+            // not a multiple of any lane width, the last batch is partial
+            std::vector<Simplify::vec3f> points(37);
+            std::vector<double> errors(points.size());
+
+            for (auto &p : points) {
+                p = Simplify::vec3f(value(random), value(random), value(random));
+            }
+
+            Simplify::vertex_error(q, points.data(), static_cast<int>(points.size()), errors.data());
+
+            for (size_t i = 0; i < points.size(); i++) {
+                double scalar = Simplify::vertex_error(q, points[i].x, points[i].y, points[i].z);
+                if (std::memcmp(&scalar, &errors[i], sizeof(double)) != 0) mismatches++;
+            }
+        }
+
+        check(mismatches == 0, std::to_string(mismatches) + " batched quadric errors differ from the scalar ones");
+    }
+
+}
+
+
+int main() {
+    clustering_keeps_faces();
+    error_bound_holds();
+    progressive_round_trip();
+    parallel_is_deterministic();
+    batched_errors_match();
+
+    if (failures == 0) {
+        fprintf(stderr, "all checks passed\n");
+    }
+
+    return failures;
+}